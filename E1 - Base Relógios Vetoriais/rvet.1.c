@@ -2,47 +2,34 @@
  * Implementação de relógios vetoriais usando MPI baseada no exemplo da URL:
  * https://people.cs.rutgers.edu/~pxk/417/notes/images/clocks-vector.png
  * 
- * Compilação: mpicc -o rvet.1 rvet.1.c
+ * Compilação: mpicc -I../comum -o rvet.1 rvet.1.c ../comum/libcomum.a (ou make)
  * Execução: mpiexec -n 3 ./rvet.1
  */
 
 #include <stdio.h>
 #include <string.h>
 #include <mpi.h>
+#include "vclock.h"
 
-typedef struct Clock {
-    int p[3];
-} Clock;
-
-void printClock(int pid, Clock *clock, const char label, int updateType, char secondLabel) {
-    switch (updateType) {
-        case 0: printf("P%d|%c (%d, %d, %d) evento interno\n", pid, label, clock->p[0], clock->p[1], clock->p[2]); break;
-        case 1: printf("P%d|%c (%d, %d, %d) envio para %c\n", pid, label, clock->p[0], clock->p[1], clock->p[2], secondLabel); break;
-        case 2: printf("P%d|%c (%d, %d, %d) recebido de %c\n", pid, label, clock->p[0], clock->p[1], clock->p[2], secondLabel); break;
-    }
-}
+VCLOCK_DEF(Clock, 3)
 
 void evento(int pid, Clock *clock, char label) {
     clock->p[pid]++;
-    printClock(pid, clock, label, 0, 0);
+    Clock_print(pid, clock, label, VC_EVENTO, 0);
 }
 
 void envio(int pid, Clock *clock, int dest, char label, char destLabel) {
     clock->p[pid]++;
     MPI_Send(clock->p, 3, MPI_INT, dest, 0, MPI_COMM_WORLD);
-    printClock(pid, clock, label, 1, destLabel);
+    Clock_print(pid, clock, label, VC_ENVIO, destLabel);
 }
 
 void recebe(int pid, Clock *clock, int source, char label, char sourceLabel) {
     int msg[3];
     MPI_Recv(msg, 3, MPI_INT, source, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-    for (int i = 0; i < 3; i++) {
-        if (msg[i] > clock->p[i]) {
-            clock->p[i] = msg[i];
-        }
-    }
+    vclock_max_n(clock->p, msg, 3);
     clock->p[pid]++;
-    printClock(pid, clock, label, 2, sourceLabel);
+    Clock_print(pid, clock, label, VC_RECEBIMENTO, sourceLabel);
 }
 
 
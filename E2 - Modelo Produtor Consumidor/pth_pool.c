@@ -5,10 +5,13 @@
  *    Implementação de um pool de threads
  *
  *
- * Compile:  gcc -g -Wall -o pth_pool pth_pool.c -lpthread -lrt
+ * Compile:  gcc -g -Wall -I../comum -o pth_pool pth_pool.c ../comum/libcomum.a -lpthread -lrt
  * Alternatively: make all
  * Usage:    ./pth_pool
  * Alternatively: make run
+ *
+ * Métricas:  make METRICAS=1 instrumenta a fila de tarefas (../comum/metricas.h);
+ *            o programa não termina: kill -USR1 <pid> imprime o resumo em stderr
  */
 
 #include <stdio.h>
@@ -17,13 +20,13 @@
 #include <unistd.h>
 #include <semaphore.h>
 #include <time.h>
+#include "vclock.h"
+#include "metricas.h"
 
 #define THREAD_NUM 6    // Tamanho do pool de threads
 #define BUFFER_SIZE 16 // Númermo máximo de tarefas enfileiradas
 
-typedef struct Clock {
-    int p[3];
-} Clock;
+VCLOCK_DEF(Clock, 3)
 
 Clock globalClock = {{0,0,0}};
 Clock taskQueue[BUFFER_SIZE];
@@ -38,10 +41,8 @@ pthread_cond_t condEmpty;
 void executeTask(Clock* task, int id){
    pthread_mutex_lock(&clock_mutex);
    
-   for (int i=0; i<3; i++) {
-       if (globalClock.p[i] < task->p[i])
-           globalClock.p[i] = task->p[i];
-   }
+   Clock_max(&globalClock, task);
+   MET_CONTA(MC_MERGE);
    printf("(Consumidor %d) (%d, %d, %d)\n", id, globalClock.p[0], globalClock.p[1], globalClock.p[2]);
 
    pthread_mutex_unlock(&clock_mutex);
@@ -50,9 +51,13 @@ void executeTask(Clock* task, int id){
 Clock getTask(){
    pthread_mutex_lock(&mutex);
    
-   while (taskCount == 0){
-      printf("BUFFER VAZIO\n");
-      pthread_cond_wait(&condEmpty, &mutex);
+   if (taskCount == 0){
+      MET_T0(t);
+      while (taskCount == 0){
+         printf("BUFFER VAZIO\n");
+         pthread_cond_wait(&condEmpty, &mutex);
+      }
+      MET_ESPERA(MF_TAREFAS, MFC_POP_BLOQ, MH_POP(MF_TAREFAS), t);
    }
    Clock task = taskQueue[0];
    int i;
@@ -60,6 +65,7 @@ Clock getTask(){
       taskQueue[i] = taskQueue[i+1];
    }
    taskCount--;
+   MET_POP(MF_TAREFAS);
    
    pthread_mutex_unlock(&mutex);
    pthread_cond_signal(&condFull);
@@ -69,13 +75,18 @@ Clock getTask(){
 void submitTask(Clock task){
    pthread_mutex_lock(&mutex);
 
-   while (taskCount == BUFFER_SIZE){
-      printf("BUFFER CHEIO\n");
-      pthread_cond_wait(&condFull, &mutex);
+   if (taskCount == BUFFER_SIZE){
+      MET_T0(t);
+      while (taskCount == BUFFER_SIZE){
+         printf("BUFFER CHEIO\n");
+         pthread_cond_wait(&condFull, &mutex);
+      }
+      MET_ESPERA(MF_TAREFAS, MFC_PUSH_BLOQ, MH_PUSH(MF_TAREFAS), t);
    }
 
    taskQueue[taskCount] = task;
    taskCount++;
+   MET_PUSH(MF_TAREFAS, taskCount);
 
    pthread_mutex_unlock(&mutex);
    pthread_cond_signal(&condEmpty);
@@ -89,6 +100,7 @@ int main(int argc, char* argv[]) {
    pthread_mutex_init(&clock_mutex, NULL);
    pthread_cond_init(&condEmpty, NULL);
    pthread_cond_init(&condFull, NULL);
+   MET_INIT("pth_pool");
 
    pthread_t thread[THREAD_NUM]; 
    long i;
@@ -2,8 +2,29 @@
  * Implementação de relógios vetoriais usando MPI baseada no exemplo da URL:
  * https://people.cs.rutgers.edu/~pxk/417/notes/images/clocks-vector.png
  * 
- * Compilação: mpicc -o rvet_pth rvet_pth.c -lpthread
- * Execução: mpiexec -n 3 ./rvet_pth
+ * Compilação: mpicc -I../comum -o rvet_pth rvet_pth.c ../comum/libcomum.a -lpthread
+ * Execução: mpiexec -n 3 ./rvet_pth [-W carga] [-e n] [-i frac] [-b n] [-s seed] [-q] [-x arq]
+ *                                   [-r arq | -y arq]
+ *           Com outro número de processos: make NP=N (compila com -DNUM_PROC=N) e
+ *           mpiexec -n N
+ *
+ *   -W carga  linha do tempo gerada (ver ../comum/carga.h): fixo (padrão, o diagrama
+ *          de 3 processos com 100 ms entre eventos) ou anel, todos, aleatorio,
+ *          estrela e rajada, sem espera entre eventos
+ *   -e n   ações (internos e envios) por processo na carga gerada (padrão 1000)
+ *   -i frac  fração de eventos internos (padrão 0.5)
+ *   -b n   envios por rajada em -W rajada (padrão 8)
+ *   -s seed  semente da carga (a mesma em todos os processos)
+ *   -q     não imprime o relógio a cada evento
+ *   -x arq trace Chrome/Perfetto em arq: fatias das três threads com o relógio em cada
+ *          evento e fluxos envio -> recebimento (ver ../comum/trace.h)
+ *   -r arq grava a ordem de entrega de cada processo em arq.<pid> (ver ../comum/gravacao.h)
+ *   -y arq reproduz uma gravação feita com a mesma carga: threadEntrada recebe de cada
+ *          remetente na ordem gravada e os relógios saem iguais, sem os 100 ms entre
+ *          eventos do diagrama fixo; com -r ou -y P0 imprime a duração da execução
+ *
+ *           make METRICAS=1: filas e mensagens instrumentadas (../comum/metricas.h);
+ *           kill -USR1 imprime o resumo em stderr, que sai também no fim de cada processo
  * 
  *
  */
@@ -15,26 +36,32 @@
 #include <pthread.h>
 #include <mpi.h>
 #include <unistd.h>
-
+#include <getopt.h>
+#include "vclock.h"
+#include "carga.h"
+#include "metricas.h"
+#include "trace.h"
+#include "gravacao.h"
+#include "pool.h"
+
+#ifndef NUM_PROC
 #define NUM_PROC 3
+#endif
 #define MAX_QUEUE 10
+#if CARGA_MAX_PEND > MAX_QUEUE
+//heurística: na ordem do gerador as pendências por destino cabem na fila; numa
+//intercalação real um remetente adiantado ainda pode encher a fila e bloquear
+#error "fila de entrada menor que as pendências da carga na ordem do gerador"
+#endif
+#define MAX_POOL (MAX_QUEUE + 2) // relógios recebidos: fila de entrada, o da recepção e o em entrega
 
-typedef struct Clock {
-    int p[NUM_PROC];
-} Clock;
-
-typedef enum { EVENTO, ENVIO, RECEBIMENTO } TipoEvento;
-
-typedef struct Evento {
-    TipoEvento tipo;
-    char label;
-    int destino_ou_origem;
-    char outroLabel;
-} Evento;
+VCLOCK_DEF(Clock, NUM_PROC)
 
 typedef struct Fila {
     Evento eventos[MAX_QUEUE];
+    int *relogios[MAX_QUEUE]; // fila de entrada: buffer do pool com o relógio recebido
     int inicio, fim, tamanho;
+    int metrica; // MF_ENTRADA ou MF_SAIDA
     pthread_mutex_t mutex;
     pthread_cond_t cond;
 } Fila;
@@ -42,85 +69,112 @@ typedef struct Fila {
 typedef struct Contexto {
     int pid;
     Clock clock;
+    pthread_mutex_t clockMutex; // threadRelogio e threadSaida avançam o mesmo relógio
     Fila filaEntrada;
     Fila filaSaida;
+    Pool pool; // relógios recebidos: threadEntrada pega, threadRelogio devolve após a entrega
     volatile int running;
+    Carga carga;
+    int quiet;
+    Gravacao grav; // -r/-y: passos da entrada própria do relógio
+    pthread_cond_t vez; // reprodução: sinalizado (sob clockMutex) a cada passo
 } Contexto;
 
-void initFila(Fila *fila) {
+void initFila(Fila *fila, int metrica) {
     fila->inicio = fila->fim = fila->tamanho = 0;
+    fila->metrica = metrica;
     pthread_mutex_init(&fila->mutex, NULL);
     pthread_cond_init(&fila->cond, NULL);
 }
 
-void pushFila(Fila *fila, Evento ev) {
+void pushFila(Fila *fila, Evento ev, int *relogio) {
     pthread_mutex_lock(&fila->mutex);
-    while (fila->tamanho == MAX_QUEUE)
-        pthread_cond_wait(&fila->cond, &fila->mutex);
+    if (fila->tamanho == MAX_QUEUE) {
+        MET_T0(t);
+        while (fila->tamanho == MAX_QUEUE)
+            pthread_cond_wait(&fila->cond, &fila->mutex);
+        MET_ESPERA(fila->metrica, MFC_PUSH_BLOQ, MH_PUSH(fila->metrica), t);
+    }
     fila->eventos[fila->fim] = ev;
+    fila->relogios[fila->fim] = relogio;
     fila->fim = (fila->fim + 1) % MAX_QUEUE;
     fila->tamanho++;
+    MET_PUSH(fila->metrica, fila->tamanho);
     pthread_cond_broadcast(&fila->cond);
     pthread_mutex_unlock(&fila->mutex);
 }
 
-Evento popFila(Fila *fila, volatile int *running) {
+Evento popFila(Fila *fila, volatile int *running, int **relogio) {
     pthread_mutex_lock(&fila->mutex);
-    while (fila->tamanho == 0 && *running)
-        pthread_cond_wait(&fila->cond, &fila->mutex);
+    if (fila->tamanho == 0 && *running) {
+        MET_T0(t);
+        while (fila->tamanho == 0 && *running)
+            pthread_cond_wait(&fila->cond, &fila->mutex);
+        MET_ESPERA(fila->metrica, MFC_POP_BLOQ, MH_POP(fila->metrica), t);
+    }
 
     Evento ev;
     if (fila->tamanho > 0) {
         ev = fila->eventos[fila->inicio];
+        if (relogio) *relogio = fila->relogios[fila->inicio];
         fila->inicio = (fila->inicio + 1) % MAX_QUEUE;
         fila->tamanho--;
+        MET_POP(fila->metrica);
     } else {
         // dummy event in case of shutdown
         ev.tipo = EVENTO;
         ev.label = '?';
         ev.destino_ou_origem = -1;
         ev.outroLabel = '?';
+        if (relogio) *relogio = NULL;
     }
     pthread_cond_broadcast(&fila->cond);
     pthread_mutex_unlock(&fila->mutex);
     return ev;
 }
 
-void printClock(int pid, Clock *clock, char label, TipoEvento tipo, char secondLabel) {
-    switch (tipo) {
-        case EVENTO:
-            printf("P%d|%c (%d, %d, %d) evento interno\n", pid, label, clock->p[0], clock->p[1], clock->p[2]);
-            break;
-        case ENVIO:
-            printf("P%d|%c (%d, %d, %d) envio para %c\n", pid, label, clock->p[0], clock->p[1], clock->p[2], secondLabel);
-            break;
-        case RECEBIMENTO:
-            printf("P%d|%c (%d, %d, %d) recebido de %c\n", pid, label, clock->p[0], clock->p[1], clock->p[2], secondLabel);
-            break;
-    }
-    fflush(stdout);
+// reprodução: com clockMutex travado, espera o relógio chegar ao passo k da gravação
+static void esperaVez(Contexto *ctx, long k) {
+    if (ctx->grav.modo != GRAV_REPRODUZ) return;
+    while (ctx->clock.p[ctx->pid] < k)
+        pthread_cond_wait(&ctx->vez, &ctx->clockMutex);
+}
+
+// depois de avançar a entrada própria, ainda com clockMutex travado
+static void passouVez(Contexto *ctx, int passo) {
+    grav_anota(&ctx->grav, passo);
+    if (ctx->grav.modo == GRAV_REPRODUZ) pthread_cond_broadcast(&ctx->vez);
 }
 
 void* threadEntrada(void* arg) {
     Contexto *ctx = (Contexto*) arg;
+    trace_thread(ctx->pid, TRACE_ENTRADA, "threadEntrada");
+    long passo = 0; // próximo recebimento na gravação
+    int *buf = NULL; // buffer do pool onde cai a próxima mensagem
     while (ctx->running) {
         int flag = 0;
         MPI_Status status;
 
-        // Verifica se há mensagem disponível
-        MPI_Iprobe(MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &flag, &status);
+        // Verifica se há mensagem disponível (ao reproduzir, só do próximo remetente gravado)
+        int de = MPI_ANY_SOURCE;
+        if (ctx->grav.modo == GRAV_REPRODUZ) {
+            passo = grav_proximo(&ctx->grav, passo, GRAV_BIT(RECEBIMENTO));
+            if (passo < ctx->grav.n) de = ctx->grav.passos[passo];
+        }
+        // pool vazio: threadRelogio ainda não devolveu nenhum buffer, tenta depois
+        if (!buf) buf = pool_pega(&ctx->pool);
+        if (buf) MPI_Iprobe(de, 0, MPI_COMM_WORLD, &flag, &status);
         if (flag) {
-            int msg[NUM_PROC];
-            MPI_Recv(msg, NUM_PROC, MPI_INT, status.MPI_SOURCE, 0, MPI_COMM_WORLD, &status);
-
-            Evento ev;
-            ev.tipo = RECEBIMENTO;
-            ev.destino_ou_origem = status.MPI_SOURCE;
-            ev.label = '?';
-            ev.outroLabel = '?';
-            memcpy(&ev.label, msg, sizeof(int) * NUM_PROC);
-
-            pushFila(&ctx->filaEntrada, ev);
+            passo++;
+            uint64_t t0 = trace_ativo ? trace_ns() : 0;
+            // recebe direto no buffer, que segue para threadRelogio só como ponteiro
+            MPI_Recv(buf, NUM_PROC, MPI_INT, status.MPI_SOURCE, 0, MPI_COMM_WORLD, &status);
+            Evento ev = {RECEBIMENTO, '?', status.MPI_SOURCE, '?'};
+            MET_CONTA(MC_MSG_REC);
+            if (trace_ativo) trace_fatia(-1, "chegada", t0, trace_ns(), 0, 0, buf, NUM_PROC);
+
+            pushFila(&ctx->filaEntrada, ev, buf);
+            buf = NULL;
         } else {
             // Não há mensagem, dá uma pausa curta para evitar busy waiting
             usleep(1000);
@@ -131,12 +185,29 @@ void* threadEntrada(void* arg) {
 
 void* threadSaida(void* arg) {
     Contexto *ctx = (Contexto*) arg;
-    while (ctx->running) {
-        Evento ev = popFila(&ctx->filaSaida, &ctx->running);
-        if (!ctx->running) break;
+    trace_thread(ctx->pid, TRACE_SAIDA, "threadSaida");
+    long passo = 0; // próximo envio na gravação
+    while (1) {
+        // esvazia a fila antes de sair: sem espera entre eventos o último envio pode chegar junto com o fim
+        Evento ev = popFila(&ctx->filaSaida, &ctx->running, NULL);
+        if (ev.tipo != ENVIO) break;
+        uint64_t t0 = trace_ativo ? trace_ns() : 0;
+        // cópia do que vai na mensagem: threadRelogio pode avançar o relógio durante o envio
+        pthread_mutex_lock(&ctx->clockMutex);
+        passo = grav_proximo(&ctx->grav, passo, GRAV_BIT(ENVIO));
+        esperaVez(ctx, passo++);
         ctx->clock.p[ctx->pid]++;
-        MPI_Send(ctx->clock.p, NUM_PROC, MPI_INT, ev.destino_ou_origem, 0, MPI_COMM_WORLD);
-        printClock(ctx->pid, &ctx->clock, ev.label, ENVIO, ev.outroLabel);
+        passouVez(ctx, GRAV_ENVIO);
+        Clock enviado = ctx->clock;
+        pthread_mutex_unlock(&ctx->clockMutex);
+        MPI_Send(enviado.p, NUM_PROC, MPI_INT, ev.destino_ou_origem, 0, MPI_COMM_WORLD);
+        MET_CONTA(MC_MSG_ENV);
+        if (trace_ativo) {
+            uint64_t t1 = trace_ns();
+            trace_fluxo('s', trace_id(ctx->pid, enviado.p[ctx->pid]), t0 + (t1 - t0) / 2);
+            trace_fatia(-1, "envio", t0, t1, ev.label, ev.outroLabel, enviado.p, NUM_PROC);
+        }
+        if (!ctx->quiet) Clock_print(ctx->pid, &enviado, ev.label, ENVIO, ev.outroLabel);
     }
     return NULL;
 }
@@ -145,77 +216,116 @@ void* threadRelogio(void* arg) {
     Contexto *ctx = (Contexto*) arg;
     int pid = ctx->pid;
 
-    Evento eventos_p0[] = {
-        {EVENTO, 'a', -1, 0},
-        {ENVIO,  'b', 1, 'l'},
-        {RECEBIMENTO, 'c', 1, 'h'},
-        {ENVIO,  'd', 2, 'm'},
-        {RECEBIMENTO, 'e', 2, 'l'},
-        {ENVIO,  'f', 1, 'j'},
-        {EVENTO, 'g', -1, 0}
-    };
-
-    Evento eventos_p1[] = {
-        {ENVIO, 'h', 0, 'c'},
-        {RECEBIMENTO, 'i', 0, 'b'},
-        {RECEBIMENTO, 'j', 0, 'f'}
-    };
-
-    Evento eventos_p2[] = {
-        {EVENTO, 'k', -1, 0},
-        {ENVIO,  'l', 0, 'e'},
-        {RECEBIMENTO, 'm', 0, 'd'}
-    };
-
-    Evento *lista;
     int count;
-    if (pid == 0) {
-        lista = eventos_p0; count = sizeof(eventos_p0)/sizeof(Evento);
-    } else if (pid == 1) {
-        lista = eventos_p1; count = sizeof(eventos_p1)/sizeof(Evento);
-    } else {
-        lista = eventos_p2; count = sizeof(eventos_p2)/sizeof(Evento);
-    }
+    Evento *lista = carga_gerar(&ctx->carga, pid, &count);
+    trace_thread(pid, TRACE_RELOGIO, "threadRelogio");
+    long passo = 0; // próximo interno ou recebimento na gravação
 
     for (int i = 0; i < count; i++) {
         Evento ev = lista[i];
+        uint64_t t0 = trace_ativo ? trace_ns() : 0;
 
         if (ev.tipo == EVENTO) {
+            pthread_mutex_lock(&ctx->clockMutex);
+            passo = grav_proximo(&ctx->grav, passo, GRAV_BIT(EVENTO) | GRAV_BIT(RECEBIMENTO));
+            esperaVez(ctx, passo++);
             ctx->clock.p[pid]++;
-            printClock(pid, &ctx->clock, ev.label, EVENTO, 0);
+            passouVez(ctx, GRAV_EVENTO);
+            Clock c = ctx->clock;
+            pthread_mutex_unlock(&ctx->clockMutex);
+            if (trace_ativo) trace_fatia(-1, "evento", t0, trace_ns(), ev.label, 0, c.p, NUM_PROC);
+            if (!ctx->quiet) Clock_print(pid, &c, ev.label, EVENTO, 0);
         } else if (ev.tipo == ENVIO) {
-            pushFila(&ctx->filaSaida, ev);
+            pushFila(&ctx->filaSaida, ev, NULL);
+            if (trace_ativo) trace_fatia(-1, "envio_fila", t0, trace_ns(), ev.label, ev.outroLabel, NULL, 0);
         } else if (ev.tipo == RECEBIMENTO) {
             while (ctx->running) {
-                Evento recv = popFila(&ctx->filaEntrada, &ctx->running);
-                int *msg = (int*)&recv.label;
-                for (int i = 0; i < NUM_PROC; i++) {
-                    if (msg[i] > ctx->clock.p[i])
-                        ctx->clock.p[i] = msg[i];
-                }
+                int *msg;
+                Evento recv = popFila(&ctx->filaEntrada, &ctx->running, &msg);
+                if (!msg) break;
+                if (trace_ativo) t0 = trace_ns();
+                int de = recv.destino_ou_origem;
+                pthread_mutex_lock(&ctx->clockMutex);
+                passo = grav_proximo(&ctx->grav, passo, GRAV_BIT(EVENTO) | GRAV_BIT(RECEBIMENTO));
+                esperaVez(ctx, passo++);
+                vclock_max_n(ctx->clock.p, msg, NUM_PROC);
                 ctx->clock.p[pid]++;
-                printClock(pid, &ctx->clock, ev.label, RECEBIMENTO, ev.outroLabel);
+                passouVez(ctx, de);
+                Clock c = ctx->clock;
+                pthread_mutex_unlock(&ctx->clockMutex);
+                MET_CONTA(MC_MERGE);
+                if (trace_ativo) {
+                    uint64_t t1 = trace_ns();
+                    trace_fluxo('f', trace_id(de, msg[de]), t0 + (t1 - t0) / 2);
+                    trace_fatia(-1, "recebimento", t0, t1, ev.label, ev.outroLabel, c.p, NUM_PROC);
+                }
+                pool_devolve(&ctx->pool, msg);
+                if (!ctx->quiet) Clock_print(pid, &c, ev.label, RECEBIMENTO, ev.outroLabel);
                 break;
             }
         }
-        usleep(100000); // delay para simular tempo
+        if (ctx->carga.padrao == CARGA_FIXA && ctx->grav.modo != GRAV_REPRODUZ)
+            usleep(100000); // delay para simular tempo
     }
+    free(lista);
     pthread_exit(NULL);
 }
 
-int main() {
-    int pid;
-    MPI_Init(NULL, NULL);
+int main(int argc, char **argv) {
+    int pid, size;
+    MPI_Init(&argc, &argv);
     MPI_Comm_rank(MPI_COMM_WORLD, &pid);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
 
     Contexto ctx;
+    carga_init(&ctx.carga, NUM_PROC);
+    ctx.quiet = 0;
+    grav_init(&ctx.grav, GRAV_NADA, NULL);
+    int opt, bad = 0;
+    while ((opt = getopt(argc, argv, "W:e:i:b:s:qx:r:y:")) != -1) {
+        switch (opt) {
+            case 'W': if (!carga_padrao(&ctx.carga, optarg)) bad = 1; break;
+            case 'e': ctx.carga.eventos = atol(optarg); break;
+            case 'i': ctx.carga.interno = atof(optarg); break;
+            case 'b': ctx.carga.rajada = atoi(optarg); break;
+            case 's': ctx.carga.seed = (unsigned)atol(optarg); break;
+            case 'q': ctx.quiet = 1; break;
+            case 'x': if (!trace_init(optarg)) { perror(optarg); bad = 1; } break;
+            case 'r': grav_init(&ctx.grav, GRAV_GRAVA, optarg); break;
+            case 'y': grav_init(&ctx.grav, GRAV_REPRODUZ, optarg); break;
+            default: bad = 1;
+        }
+    }
+    int n;
+    Evento *teste = carga_gerar(&ctx.carga, pid, &n);
+    if (bad || !teste || size != NUM_PROC) {
+        if (pid == 0)
+            fprintf(stderr, "uso: mpiexec -n %d %s [-W " CARGA_NOMES "] [-e n] [-i frac] [-b n] [-s seed] [-q] [-x trace.json]\n"
+                            "     [-r gravacao | -y gravacao]\n"
+                            "     (fixo exige 3 processos; outro número: make NP=N)\n", NUM_PROC, argv[0]);
+        free(teste);
+        MPI_Finalize();
+        return 1;
+    }
+    free(teste);
+    if (ctx.grav.modo == GRAV_REPRODUZ && !grav_carrega(&ctx.grav, pid, &ctx.carga))
+        MPI_Abort(MPI_COMM_WORLD, 1);
+
     ctx.pid = pid;
     ctx.running = 1;
     memset(&ctx.clock, 0, sizeof(Clock));
-    initFila(&ctx.filaEntrada);
-    initFila(&ctx.filaSaida);
+    pthread_mutex_init(&ctx.clockMutex, NULL);
+    pthread_cond_init(&ctx.vez, NULL);
+    initFila(&ctx.filaEntrada, MF_ENTRADA);
+    initFila(&ctx.filaSaida, MF_SAIDA);
+    if (!pool_init(&ctx.pool, MAX_POOL, sizeof(int) * NUM_PROC)) {
+        perror("pool de relógios");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MET_INIT("rvet_pth");
 
     pthread_t tEntrada, tRelogio, tSaida;
+    double t0 = MPI_Wtime();
 
     pthread_create(&tEntrada, NULL, threadEntrada, &ctx);
     pthread_create(&tSaida, NULL, threadSaida, &ctx);
@@ -230,6 +340,22 @@ int main() {
 
     pthread_join(tEntrada, NULL);
     pthread_join(tSaida, NULL);
+    double dur = MPI_Wtime() - t0, dur_max = 0;
+    MET_FIM();
+    if (ctx.grav.modo != GRAV_NADA) {
+        MPI_Reduce(&dur, &dur_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        if (pid == 0)
+            printf("Duração (%s): %.3f s\n", ctx.grav.modo == GRAV_GRAVA ? "gravação" : "reprodução", dur_max);
+    }
+    if (ctx.grav.modo == GRAV_GRAVA) grav_salva(&ctx.grav, pid, &ctx.carga);
+    grav_libera(&ctx.grav);
+    pool_libera(&ctx.pool);
+    // cada processo grava a sua parte; P0 junta depois que todos terminaram
+    if (trace_ativo) {
+        trace_fim(pid);
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (pid == 0) trace_junta(size, NUM_PROC);
+    }
 
     MPI_Finalize();
     return 0;
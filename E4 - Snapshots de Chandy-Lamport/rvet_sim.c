@@ -0,0 +1,535 @@
+/**
+ * Etapa 4 - Simulação
+ * Relógios vetoriais e snapshots de Chandy-Lamport da Etapa 4 com milhares de processos
+ * lógicos dentro de um único processo do sistema operacional
+ *
+ * Compilação: gcc -O2 -I../comum -o rvet_sim rvet_sim.c ../comum/libcomum.a -lpthread (ou make)
+ * Execução: ./rvet_sim [-N procs] [-w workers] [-r rondas] [-s rondas] [-l ticks] [-v]
+ *
+ *   -N n   processos lógicos (padrão 3: a linha do tempo fixa de ../comum/carga.h, que
+ *          reproduz os relógios de referência; com outro N cada processo faz -r rondas de evento
+ *          interno, envio ao sucessor e recebimento do antecessor num anel)
+ *   -w n   threads trabalhadoras que executam os processos (padrão 4)
+ *   -r n   rondas do anel (padrão 10)
+ *   -s n   P0 inicia um snapshot a cada n rondas do anel, ou no evento 'a' da linha do
+ *          tempo fixa (padrão 1, 0 desliga). Um disparo que encontra o snapshot anterior
+ *          em andamento bloqueia a corrotina de P0 até a época fechar em todos (o último
+ *          processo manda MSG_FIM a P0): o número de snapshots não depende de -w
+ *   -l n   latência dos canais em ticks de tempo virtual (padrão 5)
+ *   -v     imprime o relógio de cada evento (ligado na linha do tempo fixa)
+ *
+ * Cada processo é uma corrotina sem pilha: o estado fica todo no Processo (índice do
+ * próximo evento, relógio e canais de entrada) e a corrotina devolve a worker ao
+ * bloquear num recebimento ou depois de QUANTUM eventos. Os canais são caixas de correio
+ * em memória e o escalonador entrega às workers o processo pronto de menor tempo virtual,
+ * só como prioridade: não é uma simulação de eventos discretos, e a caixa de correio é
+ * drenada na ordem real de chegada. O recebimento consome o canal da origem indicada no
+ * Evento, então os relógios finais não dependem do número de workers nem da intercalação.
+ *
+ * O corte também não: o marker entra na fila FIFO do canal e o processo só corta quando
+ * alcança a posição dele, antes de receber a primeira mensagem que veio depois (ou no fim
+ * da linha do tempo). Mensagens em canal e a duração em tempo virtual (markers avançam
+ * -l ticks por aresta) saem iguais para qualquer -w; só fechamento_ms é tempo real.
+ *
+ * Markers seguem só pelos canais que a linha do tempo usa (grafo de comunicação), não
+ * por todos os N*(N-1) pares: o corte continua sendo o de Chandy-Lamport com canais
+ * FIFO e a verificação de consistência é a mesma do -g da Etapa 4, feita com o máximo
+ * por coluna acumulado a cada corte local em vez dos N relógios inteiros.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <stdatomic.h>
+#include "vclock.h"
+#include "carga.h"
+
+#define MAX_SNAPS 64 //custos guardados por época
+#define MAX_VIZ 2 //canais de entrada/saída por processo (anel e linha do tempo fixa)
+#define QUANTUM 64 //eventos por fatia antes de devolver a worker ao escalonador
+
+/* ----------------------------- Relógio Vetorial ---------------------------- */
+
+//N só é conhecido na execução: cada relógio é uma linha de N ints (vclock_* dinâmico)
+static int N = 3;
+
+/* --------------------------------- Mensagens ------------------------------- */
+
+typedef enum { MSG_NORMAL = 1, MSG_MARKER = 2, MSG_FIM = 3 } MsgType;
+
+typedef struct Msg {
+    struct Msg *prox;
+    int type;
+    int from;
+    int epoch; //época do marker
+    char label;
+    long t; //tempo virtual de chegada ao destino
+    int clock[]; //N entradas (vazio nos markers)
+} Msg;
+
+//fila FIFO encadeada: caixa de correio e canais de entrada
+typedef struct { Msg *ini, *fim; } Canal;
+
+static void canal_push(Canal *c, Msg *m){ m->prox=NULL; if(c->fim) c->fim->prox=m; else c->ini=m; c->fim=m; }
+static Msg *canal_pop(Canal *c){
+    Msg *m=c->ini;
+    if(m){ c->ini=m->prox; if(!c->ini) c->fim=NULL; }
+    return m;
+}
+
+static inline double agora(void){
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* --------------------------------- Processos ------------------------------- */
+
+typedef enum { LP_PRONTO, LP_BLOQUEADO } EstadoLP;
+
+typedef struct Processo {
+    int pid;
+    int *clock;
+    Evento *linha; //linha do tempo fixa (carga_gerar); NULL no anel, gerado evento a evento
+    int pc, count; //próximo evento da linha do tempo / total
+    long vt; //tempo virtual
+    long enviadas;
+
+    //caixa de correio: a única parte tocada pelas workers de outros processos
+    pthread_mutex_t m;
+    Canal caixa;
+    EstadoLP estado;
+
+    //já retiradas da caixa, por origem, aguardando o RECEBIMENTO
+    int nin, in_src[MAX_VIZ];
+    Canal in[MAX_VIZ];
+    int nout, out_dst[MAX_VIZ];
+
+    //snapshot local
+    int snap_epoch; //última época em que cortou (-1 nenhuma)
+    int faltam; //canais de entrada ainda sem marker
+    int rec[MAX_VIZ]; //canal gravando mensagens em trânsito
+    int cut_own; //clock[pid] no corte
+    long canal_msgs;
+    long t_corte, t_fim;
+} Processo;
+
+typedef struct {
+    long markers, canal_msgs, t_ini, t_fim;
+    double ms;
+    int consistente;
+} Resultado;
+
+//campos protegidos por m (exceto markers)
+typedef struct {
+    pthread_mutex_t m;
+    int epoch; //última época iniciada por P0
+    int pendentes; //processos que ainda não fecharam os canais da época
+    atomic_long markers;
+    int *colmax; //máximo por coluna dos relógios locais do corte
+    long canal_msgs, t_ini, t_fim;
+    double t0;
+    int skipped; //disparos além de MAX_SNAPS
+    Resultado res[MAX_SNAPS];
+} Snap;
+
+//escalonador: heap de processos prontos por tempo virtual
+typedef struct {
+    Processo **heap;
+    int n, ativos;
+    pthread_mutex_t m;
+    pthread_cond_t c;
+} Escalonador;
+
+static Processo *lps;
+static Escalonador esc;
+static Snap snap;
+static int diagrama, rondas = 10, snap_cada = 1, lat = 5, verbose;
+
+/* ------------------------------ Linha do tempo ----------------------------- */
+
+static void evento(const Processo *lp, int pc, Evento *ev){
+    if(lp->linha){
+        *ev = lp->linha[pc];
+        return;
+    }
+    int pid = lp->pid;
+    //anel: interno, envio ao sucessor, recebimento do antecessor; o envio da ronda r
+    //(pc 3r+1) é recebido na mesma ronda do outro lado (pc 3r+2)
+    ev->label = 'a' + pc % 26;
+    switch(pc % 3){
+        case 0: ev->tipo=EVENTO; ev->destino_ou_origem=-1; ev->outroLabel=0; break;
+        case 1: ev->tipo=ENVIO; ev->destino_ou_origem=(pid+1)%N; ev->outroLabel='a' + (pc+1) % 26; break;
+        default: ev->tipo=RECEBIMENTO; ev->destino_ou_origem=(pid-1+N)%N; ev->outroLabel='a' + (pc-1) % 26; break;
+    }
+}
+
+static void viz_add(int *lista, int *n, int p){
+    for(int k=0;k<*n;k++) if(lista[k]==p) return;
+    if(*n == MAX_VIZ){ fprintf(stderr, "mais de %d vizinhos\n", MAX_VIZ); exit(1); }
+    lista[(*n)++] = p;
+}
+
+static int canal_de(const Processo *lp, int origem){
+    for(int k=0;k<lp->nin;k++) if(lp->in_src[k]==origem) return k;
+    return -1;
+}
+
+/* -------------------------------- Escalonador ------------------------------ */
+
+static int esc_antes(const Processo *a, const Processo *b){
+    return a->vt < b->vt || (a->vt == b->vt && a->pid < b->pid);
+}
+
+//chamadas com esc.m travado
+static void heap_push(Processo *lp){
+    int i = esc.n++;
+    while(i > 0 && esc_antes(lp, esc.heap[(i-1)/2])){ esc.heap[i] = esc.heap[(i-1)/2]; i = (i-1)/2; }
+    esc.heap[i] = lp;
+}
+
+static Processo *heap_pop(void){
+    Processo *top = esc.heap[0], *ult = esc.heap[--esc.n];
+    int i = 0;
+    for(;;){
+        int f = 2*i+1;
+        if(f >= esc.n) break;
+        if(f+1 < esc.n && esc_antes(esc.heap[f+1], esc.heap[f])) f++;
+        if(!esc_antes(esc.heap[f], ult)) break;
+        esc.heap[i] = esc.heap[f]; i = f;
+    }
+    esc.heap[i] = ult;
+    return top;
+}
+
+static void esc_push(Processo *lp){
+    pthread_mutex_lock(&esc.m);
+    heap_push(lp);
+    pthread_cond_signal(&esc.c);
+    pthread_mutex_unlock(&esc.m);
+}
+
+//deposita na caixa do destino e acorda a corrotina se ela estava esperando
+static void entrega(Processo *dst, Msg *m){
+    pthread_mutex_lock(&dst->m);
+    canal_push(&dst->caixa, m);
+    int acorda = dst->estado == LP_BLOQUEADO;
+    if(acorda) dst->estado = LP_PRONTO;
+    pthread_mutex_unlock(&dst->m);
+    if(acorda) esc_push(dst);
+}
+
+static Msg *msg_nova(int type, int from, int com_clock){
+    Msg *m = malloc(sizeof(Msg) + (com_clock ? N*sizeof(int) : 0));
+    m->type=type; m->from=from; m->epoch=0; m->label=0;
+    return m;
+}
+
+/* ------------------------- Snapshot (Chandy-Lamport) ----------------------- */
+
+//decremento e resultado na mesma seção crítica: P0 só abre a época seguinte com o resultado publicado
+static void snapshot_conclui(Processo *lp){
+    pthread_mutex_lock(&snap.m);
+    snap.canal_msgs += lp->canal_msgs;
+    if(lp->t_fim > snap.t_fim) snap.t_fim = lp->t_fim;
+    if(--snap.pendentes > 0){ pthread_mutex_unlock(&snap.m); return; }
+
+    //último processo da época: todos os cortes locais já foram acumulados em colmax
+    int ok = 1;
+    for(int i=0;i<N;i++) ok &= lps[i].cut_own >= snap.colmax[i];
+    Resultado *r = &snap.res[snap.epoch];
+    r->markers = atomic_load(&snap.markers); r->canal_msgs = snap.canal_msgs;
+    r->t_ini = snap.t_ini; r->t_fim = snap.t_fim; r->ms = (agora() - snap.t0) * 1000.0;
+    r->consistente = ok;
+    if(verbose)
+        printf("Snapshot %d: consistente %s, %ld markers, %ld mensagens em canal, duração de %ld ticks\n",
+               snap.epoch, ok ? "sim" : "NÃO", r->markers, r->canal_msgs, r->t_fim - r->t_ini);
+    pthread_mutex_unlock(&snap.m);
+    //acorda P0 se ele espera esta época para disparar a próxima
+    entrega(&lps[0], msg_nova(MSG_FIM, lp->pid, 0));
+}
+
+static void snapshot_fecha(Processo *lp, int k, long t){
+    lp->rec[k] = 0;
+    if(t > lp->t_fim) lp->t_fim = t;
+    if(--lp->faltam == 0) snapshot_conclui(lp);
+}
+
+//grava o estado local e manda markers pelos canais de saída. Os canais de entrada são
+//contados pela posição na fila: o que está antes do marker estava em trânsito no corte
+static void snapshot_corte(Processo *lp, int epoch, long t){
+    lp->snap_epoch = epoch;
+    lp->cut_own = lp->clock[lp->pid];
+    pthread_mutex_lock(&snap.m);
+    vclock_max(snap.colmax, lp->clock, N);
+    pthread_mutex_unlock(&snap.m);
+
+    for(int k=0;k<lp->nout;k++){
+        Msg *mk = msg_nova(MSG_MARKER, lp->pid, 0);
+        mk->epoch = epoch; mk->t = t + lat;
+        entrega(&lps[lp->out_dst[k]], mk);
+    }
+    atomic_fetch_add(&snap.markers, lp->nout);
+
+    lp->faltam = lp->nin; lp->canal_msgs = 0; lp->t_corte = lp->t_fim = t;
+    if(lp->nin == 0){ snapshot_conclui(lp); return; }
+    for(int k=0;k<lp->nin;k++){
+        Msg *ant = NULL, *m = lp->in[k].ini;
+        for(; m && m->type != MSG_MARKER; ant = m, m = m->prox) lp->canal_msgs++;
+        if(!m){ lp->rec[k] = 1; continue; }
+        //marker já na fila: o canal fecha com as mensagens à frente dele
+        if(ant) ant->prox = m->prox; else lp->in[k].ini = m->prox;
+        if(lp->in[k].fim == m) lp->in[k].fim = ant;
+        long tf = m->t > t ? m->t : t;
+        free(m);
+        snapshot_fecha(lp, k, tf);
+    }
+}
+
+//primeiro marker ainda na fila de algum canal de entrada
+static Msg *marker_pendente(const Processo *lp){
+    for(int k=0;k<lp->nin;k++)
+        for(Msg *m=lp->in[k].ini; m; m=m->prox)
+            if(m->type == MSG_MARKER) return m;
+    return NULL;
+}
+
+//o processo alcança o marker: o tempo virtual avança até a chegada dele e o corte acontece
+static void marker_alcancado(Processo *lp, const Msg *mk){
+    if(mk->t > lp->vt) lp->vt = mk->t;
+    snapshot_corte(lp, mk->epoch, lp->vt);
+}
+
+static int snapshot_ocupado(void){
+    pthread_mutex_lock(&snap.m);
+    int ocupado = snap.pendentes > 0;
+    pthread_mutex_unlock(&snap.m);
+    return ocupado;
+}
+
+//só P0 inicia, e só com a época anterior concluída em todos (lp_resume espera por isso)
+static void snapshot_inicia(Processo *lp){
+    pthread_mutex_lock(&snap.m);
+    if(snap.pendentes > 0 || snap.epoch+1 >= MAX_SNAPS){ snap.skipped++; pthread_mutex_unlock(&snap.m); return; }
+    int e = ++snap.epoch;
+    memset(snap.colmax, 0, N*sizeof(int));
+    atomic_store(&snap.markers, 0);
+    snap.canal_msgs = 0; snap.t_ini = snap.t_fim = lp->vt; snap.t0 = agora();
+    snap.pendentes = N;
+    pthread_mutex_unlock(&snap.m);
+    snapshot_corte(lp, e, lp->vt);
+}
+
+/* -------------------------------- Corrotinas ------------------------------- */
+
+//move a caixa de correio para os canais de entrada. Um marker antes do corte fica na fila
+//do canal, na ordem FIFO: o corte só acontece quando o processo chega até ele (lp_resume),
+//não quando uma worker drena a caixa, então o corte não depende de -w
+static void caixa_drena(Processo *lp){
+    pthread_mutex_lock(&lp->m);
+    Msg *m = lp->caixa.ini;
+    lp->caixa.ini = lp->caixa.fim = NULL;
+    pthread_mutex_unlock(&lp->m);
+    while(m){
+        Msg *prox = m->prox;
+        int k = canal_de(lp, m->from);
+        if(m->type == MSG_FIM){
+            free(m);
+        } else if(k < 0){
+            //markers e mensagens só seguem arestas do grafo de comunicação
+            fprintf(stderr, "P%d: mensagem de P%d, que não é vizinho, descartada\n", lp->pid, m->from);
+            free(m);
+        } else if(m->type == MSG_MARKER && lp->snap_epoch >= m->epoch){
+            snapshot_fecha(lp, k, m->t > lp->t_corte ? m->t : lp->t_corte);
+            free(m);
+        } else {
+            if(lp->rec[k]) lp->canal_msgs++;
+            canal_push(&lp->in[k], m);
+        }
+        m = prox;
+    }
+}
+
+//evento em que P0 inicia um snapshot
+static int disparo(const Processo *lp, const Evento *ev){
+    return lp->pid==0 && ev->tipo==EVENTO && snap_cada > 0 && (diagrama ? ev->label=='a' : (lp->pc/3) % snap_cada == 0);
+}
+
+static void executa(Processo *lp, const Evento *ev){
+    int pid = lp->pid;
+    if(ev->tipo==EVENTO){
+        lp->clock[pid]++; lp->vt++;
+        if(verbose) vclock_print(lp->pid, lp->clock, N, ev->label, ev->tipo, ev->outroLabel);
+        if(disparo(lp, ev)) snapshot_inicia(lp);
+    } else if(ev->tipo==ENVIO){
+        lp->clock[pid]++; lp->vt++;
+        Msg *m = msg_nova(MSG_NORMAL, pid, 1);
+        memcpy(m->clock, lp->clock, N*sizeof(int));
+        m->label = ev->label; m->t = lp->vt + lat;
+        lp->enviadas++;
+        if(verbose) vclock_print(lp->pid, lp->clock, N, ev->label, ev->tipo, ev->outroLabel);
+        entrega(&lps[ev->destino_ou_origem], m);
+    } else {
+        Msg *m = canal_pop(&lp->in[canal_de(lp, ev->destino_ou_origem)]);
+        vclock_max(lp->clock, m->clock, N);
+        lp->clock[pid]++;
+        lp->vt = (m->t > lp->vt ? m->t : lp->vt) + 1;
+        if(verbose) vclock_print(lp->pid, lp->clock, N, ev->label, ev->tipo, ev->outroLabel);
+        free(m);
+    }
+}
+
+//retoma a corrotina de onde parou; devolve LP_BLOQUEADO se precisa esperar mensagem
+static EstadoLP lp_resume(Processo *lp){
+    int passos = 0;
+    for(;;){
+        caixa_drena(lp);
+        if(passos == QUANTUM) return LP_PRONTO;
+        if(lp->pc < lp->count){
+            Evento ev;
+            evento(lp, lp->pc, &ev);
+            Msg *h = ev.tipo == RECEBIMENTO ? lp->in[canal_de(lp, ev.destino_ou_origem)].ini : NULL;
+            //a mensagem a receber vem depois de um marker: corta antes de recebê-la
+            if(h && h->type == MSG_MARKER){ marker_alcancado(lp, h); continue; }
+            int pode = ev.tipo == RECEBIMENTO ? h != NULL : !disparo(lp, &ev) || !snapshot_ocupado();
+            if(pode){
+                executa(lp, &ev);
+                lp->pc++; passos++;
+                continue;
+            }
+        } else {
+            //fim da linha do tempo: o corte fica depois do último evento
+            Msg *mk = marker_pendente(lp);
+            if(mk){ marker_alcancado(lp, mk); continue; }
+        }
+        //nada a fazer até chegar mensagem (ou marker, depois do fim da linha do tempo, ou MSG_FIM)
+        pthread_mutex_lock(&lp->m);
+        if(!lp->caixa.ini){
+            lp->estado = LP_BLOQUEADO;
+            pthread_mutex_unlock(&lp->m);
+            return LP_BLOQUEADO;
+        }
+        pthread_mutex_unlock(&lp->m);
+    }
+}
+
+static void *threadWorker(void *arg){
+    (void)arg;
+    pthread_mutex_lock(&esc.m);
+    for(;;){
+        while(esc.n==0 && esc.ativos>0) pthread_cond_wait(&esc.c,&esc.m);
+        //ninguém pronto e ninguém rodando: nenhuma mensagem pode mais chegar
+        if(esc.n==0) break;
+        Processo *lp = heap_pop();
+        esc.ativos++;
+        pthread_mutex_unlock(&esc.m);
+
+        EstadoLP st = lp_resume(lp);
+
+        pthread_mutex_lock(&esc.m);
+        esc.ativos--;
+        if(st==LP_PRONTO) heap_push(lp);
+        if(esc.n > 0) pthread_cond_signal(&esc.c);
+        else if(esc.ativos==0) pthread_cond_broadcast(&esc.c);
+    }
+    pthread_cond_broadcast(&esc.c);
+    pthread_mutex_unlock(&esc.m);
+    return NULL;
+}
+
+/* ---------------------------------- Main ----------------------------------- */
+
+static void usage(const char *prog){
+    fprintf(stderr, "uso: %s [-N procs] [-w workers] [-r rondas] [-s rondas] [-l ticks] [-v]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv){
+    int workers = 4, opt;
+    while((opt = getopt(argc, argv, "N:w:r:s:l:v")) != -1){
+        switch(opt){
+            case 'N': N = atoi(optarg); break;
+            case 'w': workers = atoi(optarg); break;
+            case 'r': rondas = atoi(optarg); break;
+            case 's': snap_cada = atoi(optarg); break;
+            case 'l': lat = atoi(optarg); break;
+            case 'v': verbose = 1; break;
+            default: usage(argv[0]);
+        }
+    }
+    if(N < 2 || workers < 1 || rondas < 1 || lat < 0) usage(argv[0]);
+    diagrama = N == 3;
+    if(diagrama) verbose = 1;
+
+    //N relógios de N entradas num só bloco
+    int *clocks = calloc((size_t)N*N, sizeof(int));
+    lps = calloc(N, sizeof(Processo));
+    esc.heap = malloc(N*sizeof(Processo*));
+    snap.colmax = calloc(N, sizeof(int));
+    if(!clocks || !lps || !esc.heap || !snap.colmax){ fprintf(stderr, "memória insuficiente para N=%d\n", N); return 1; }
+    pthread_mutex_init(&esc.m,NULL); pthread_cond_init(&esc.c,NULL);
+    pthread_mutex_init(&snap.m,NULL);
+    snap.epoch = -1;
+
+    //grafo de comunicação a partir da linha do tempo: por onde os markers passam
+    for(int p=0;p<N;p++){
+        Processo *lp = &lps[p];
+        lp->pid = p; lp->clock = clocks + (size_t)p*N;
+        lp->count = 3*rondas; lp->snap_epoch = -1;
+        if(diagrama){
+            Carga c; carga_init(&c, N);
+            lp->linha = carga_gerar(&c, p, &lp->count);
+        }
+        pthread_mutex_init(&lp->m,NULL);
+        //o anel se repete a cada ronda: basta a primeira
+        int lim = diagrama ? lp->count : 3;
+        for(int pc=0;pc<lim;pc++){
+            Evento ev; evento(lp, pc, &ev);
+            if(ev.tipo==ENVIO) viz_add(lp->out_dst, &lp->nout, ev.destino_ou_origem);
+            else if(ev.tipo==RECEBIMENTO) viz_add(lp->in_src, &lp->nin, ev.destino_ou_origem);
+        }
+        heap_push(lp);
+    }
+
+    double t0 = agora();
+    pthread_t *th = malloc(workers*sizeof(pthread_t));
+    for(int w=0;w<workers;w++) pthread_create(&th[w],NULL,threadWorker,NULL);
+    for(int w=0;w<workers;w++) pthread_join(th[w],NULL);
+    double dur = agora() - t0;
+
+    long eventos = 0, msgs = 0, vt = 0; long long soma = 0; int parados = 0;
+    for(int p=0;p<N;p++){
+        Processo *lp = &lps[p];
+        if(lp->pc < lp->count){
+            if(parados++ < 5) fprintf(stderr, "P%d parou no evento %d de %d\n", p, lp->pc, lp->count);
+        }
+        eventos += lp->pc; msgs += lp->enviadas;
+        if(lp->vt > vt) vt = lp->vt;
+        for(int i=0;i<N;i++) soma += lp->clock[i];
+        for(int k=0;k<lp->nin;k++){ Msg *m; while((m = canal_pop(&lp->in[k]))) free(m); }
+        free(lp->linha);
+    }
+    printf("Simulação: %d processos, %d workers: %ld eventos, %ld mensagens em %.3f s (%.0f eventos/s), tempo virtual %ld\n",
+           N, workers, eventos, msgs, dur, eventos / dur, vt);
+    //não depende de -w: compara execuções com números diferentes de workers
+    printf("Soma dos relógios finais: %lld\n", soma);
+
+    int n = snap.epoch + 1, ok = 0;
+    if(snap.pendentes > 0){ fprintf(stderr, "snapshot %d não concluiu\n", snap.epoch); n--; }
+    for(int e=0;e<n;e++) ok += snap.res[e].consistente;
+    printf("Snapshots: %d concluídos (%d consistentes), %d disparos descartados (além de MAX_SNAPS)\n", n, ok, snap.skipped);
+    if(n > 0){
+        printf("snap,markers,msgs_canal,inicio_vt,duracao_vt,fechamento_ms,consistente\n");
+        for(int e=0;e<n;e++){
+            Resultado *r = &snap.res[e];
+            printf("%d,%ld,%ld,%ld,%ld,%.3f,%d\n", e, r->markers, r->canal_msgs, r->t_ini, r->t_fim - r->t_ini, r->ms, r->consistente);
+        }
+    }
+
+    free(th); free(esc.heap); free(snap.colmax); free(lps); free(clocks);
+    return parados > 0 || ok < n;
+}
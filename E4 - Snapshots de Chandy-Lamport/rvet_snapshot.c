@@ -2,8 +2,62 @@
  * Etapa 4
  * Implementação dos Snaphots de Chandy-Lamport sobre os relógios vetoriais da Etapa 3
  * 
- * Compilação: mpicc -o rvet_snapshot rvet_snapshot.c -lpthread
- * Execução: mpiexec -n 3 ./rvet_snapshot
+ * Compilação: mpicc -I../comum -o rvet_snapshot rvet_snapshot.c ../comum/libcomum.a -lpthread (ou make)
+ * Execução: mpiexec -n 3 ./rvet_snapshot [-m cl|ly] [-f ms] [-g] [-T ms] [-K n] [-j ms] [-n max] [-p]
+ *                                         [-W carga] [-e n] [-i frac] [-b n] [-s seed] [-q] [-x arq]
+ *                                         [-r arq | -y arq] [-w n] [-u ns]
+ *           ./rvet_snapshot -t shm [...]   (sem mpiexec: NUM_PROC threads-processo)
+ *           Com mais processos: make NP=8 (compila com -DNUM_PROC=8) e mpiexec -n 8
+ *
+ *   -m cl  Chandy-Lamport com markers explícitos (padrão, exige canais FIFO)
+ *   -m ly  Lai-Yang: cor/época piggybacked em cada Msg e contadores por canal,
+ *          sem markers; canais ociosos recebem um único MSG_LY_CTRL após -f ms. Só os
+ *          canais do grafo de comunicação da linha do tempo contam (destinos dos envios,
+ *          origens dos recebimentos): pares que nunca trocam mensagens não recebem controle
+ *   -f ms  espera antes de enviar MSG_LY_CTRL aos canais sem mensagem vermelha (padrão 100)
+ *   -g     junta os fragmentos numa árvore binária enraizada no iniciador, que monta
+ *          o corte global e verifica sua consistência (profundidade log2 N)
+ *   -T ms  agenda um snapshot em P0 a cada T ms (com -j: ± jitter uniforme)
+ *   -K n   agenda um snapshot em P0 a cada n eventos da aplicação
+ *   -n max limita o número de snapshots iniciados pelo agendador (padrão MAX_SNAPS);
+ *          disparos descartados não contam
+ *          Sem -T/-K vale o disparo fixo no primeiro evento interno de P0 ('a' no
+ *          diagrama). Um disparo que encontra o snapshot anterior ainda em andamento
+ *          em algum processo é descartado (no máximo um por vez; sem -g cada processo
+ *          avisa o iniciador com MSG_FIM ao concluir).
+ *          Ao final P0 imprime o custo de cada snapshot (CSV).
+ *   -p     motor de progresso único: só a thread principal chama MPI (basta
+ *          MPI_THREAD_FUNNELED); as demais entregam envios numa fila sem trava.
+ *          Sem -p cada thread chama MPI diretamente (exige MPI_THREAD_MULTIPLE).
+ *          Ao final P0 imprime taxa de mensagens e latência média de entrega.
+ *   -t mpi|shm  transporte: MPI (padrão) ou memória compartilhada num só processo,
+ *          cada processo lógico vira uma thread e cada par (origem, destino) tem
+ *          anéis SPSC próprios; relógio e snapshot não mudam.
+ *   -W carga  linha do tempo gerada (ver ../comum/carga.h): fixo (padrão, o diagrama
+ *          de 3 processos com 100 ms entre eventos) ou anel, todos, aleatorio,
+ *          estrela e rajada, sem espera entre eventos
+ *   -e n   ações (internos e envios) por processo na carga gerada (padrão 1000)
+ *   -i frac  fração de eventos internos (padrão 0.5)
+ *   -b n   envios por rajada em -W rajada (padrão 8)
+ *   -s seed  semente da carga (a mesma em todos os processos)
+ *   -q     não imprime o relógio a cada evento
+ *   -x arq trace Chrome/Perfetto em arq: fatias das threads e das fases do snapshot, com o
+ *          relógio em cada evento, e fluxos envio -> recebimento (ver ../comum/trace.h)
+ *   -r arq grava a ordem de entrega de cada processo em arq.<pid> (ver ../comum/gravacao.h)
+ *   -y arq reproduz uma gravação feita com a mesma carga: mesma ordem de entrega e mesmos
+ *          relógios, sem os 100 ms entre eventos do diagrama fixo. Os snapshots continuam
+ *          sendo disparados em tempo real e o corte pode cair em outro ponto.
+ *   -w n   n threads de aplicação por processo (padrão 1, máx MAX_WORKERS): pegam os eventos
+ *          da linha do tempo por um índice compartilhado e avançam o mesmo relógio. Cada
+ *          passo do relógio é feito sob a trava do snapshot, que lineariza os eventos dos
+ *          workers (a entrada do processo continua sendo uma só, como num processo
+ *          sequencial) e faz o corte cair entre passos de todos eles; só a atualização do
+ *          vetor fica na seção crítica. Não combina com -r nem -y.
+ *   -u ns  trabalho da aplicação em cada evento (espera ativa fora da trava); com -w ou -u
+ *          P0 imprime a vazão em eventos/s, para comparar números de workers
+ *
+ *           make METRICAS=1: filas, mensagens e snapshots instrumentados (../comum/metricas.h);
+ *           kill -USR1 imprime o resumo em stderr, que sai também no fim de cada processo
  * 
  *
  */
@@ -15,44 +69,66 @@
 #include <pthread.h>
 #include <mpi.h>
 #include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "vclock.h"
+#include "carga.h"
+#include "metricas.h"
+#include "trace.h"
+#include "gravacao.h"
+#include "pool.h"
 
+#ifndef NUM_PROC
 #define NUM_PROC 3
+#endif
 #define MAX_QUEUE 32
+#if CARGA_MAX_PEND > MAX_QUEUE
+//heurística: na ordem do gerador as pendências por destino cabem na fila; numa
+//intercalação real um remetente adiantado ainda pode encher a fila e bloquear
+#error "fila de entrada menor que as pendências da carga na ordem do gerador"
+#endif
+#define MAX_POOL (MAX_QUEUE + 2) //buffers de Msg: fila de entrada, o da recepção e o em entrega
+#define MAX_SNAPS 64 //custos guardados por época
+#define MAX_WORKERS 64 //-w: threads de aplicação por processo
+#define MAX_SAIDA 256 //fila de envios do motor de progresso (potência de 2)
+#define MAX_INFLIGHT 64 //MPI_Isend pendentes no motor de progresso
+#define CACHE_LINE 64
+#define SHM_ANEL 64 //posições de cada anel SPSC do transporte shm (potência de 2)
+#define MAX_RED (3*MAX_SNAPS) //maior redução feita no encerramento
 
 /* ----------------------------- Relógio Vetorial ---------------------------- */
 
-typedef struct Clock {
-    int p[NUM_PROC];
-} Clock;
-
-static inline void clock_max(Clock *dst, const Clock *src) {
-    for (int i = 0; i < NUM_PROC; i++)
-        if (src->p[i] > dst->p[i]) dst->p[i] = src->p[i];
-}
-
-/* --------------------------------- Eventos --------------------------------- */
-
-typedef enum { EVENTO, ENVIO, RECEBIMENTO } TipoEvento;
-
-typedef struct Evento {
-    TipoEvento tipo;
-    char label;
-    int destino_ou_origem;
-    char outroLabel;
-} Evento;
+VCLOCK_DEF(Clock, NUM_PROC)
 
 /* ------------------------------- Mensagens MPI ----------------------------- */
 
-typedef enum { MSG_NORMAL = 1, MSG_MARKER = 2 } MsgType;
+//MSG_FIM: sem -g, cada processo avisa o iniciador que concluiu a época 'color'
+typedef enum { MSG_NORMAL = 1, MSG_MARKER = 2, MSG_LY_CTRL = 3, MSG_FIM = 4 } MsgType;
 
 typedef struct Msg {
     int type;
     int from;
     int to;
+    int color; //época do remetente no envio (cor Lai-Yang; 0 = branca)
+    int root; //iniciador da época 'color'
+    int cut_sent; //mensagens que o remetente enviou a 'to' antes do seu último corte
     char label;
+    double t_envio; //agora() no remetente, para latência de entrega
     Clock clock;
 } Msg;
 
+//relógio monotônico do sistema: comparável entre processos do mesmo nó e seguro fora da thread MPI
+static inline double agora(void){
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#define TAG_APP 0
+#define TAG_REPORT 1 //fragmentos subindo a árvore de coleta
+
 /* ------------------------------ Filas Thread-Safe -------------------------- */
 
 typedef struct {
@@ -65,50 +141,363 @@ typedef struct {
 static void filaEvento_init(FilaEvento *q){ q->ini=q->fim=q->size=0; pthread_mutex_init(&q->m,NULL); pthread_cond_init(&q->c,NULL);} 
 static void filaEvento_push(FilaEvento *q, Evento ev){
     pthread_mutex_lock(&q->m);
-    while(q->size==MAX_QUEUE) pthread_cond_wait(&q->c,&q->m);
-    q->buf[q->fim]=ev; q->fim=(q->fim+1)%MAX_QUEUE; q->size++; pthread_cond_broadcast(&q->c); pthread_mutex_unlock(&q->m);
+    if(q->size==MAX_QUEUE){
+        MET_T0(t); while(q->size==MAX_QUEUE) pthread_cond_wait(&q->c,&q->m);
+        MET_ESPERA(MF_SAIDA, MFC_PUSH_BLOQ, MH_PUSH(MF_SAIDA), t); }
+    q->buf[q->fim]=ev; q->fim=(q->fim+1)%MAX_QUEUE; q->size++; MET_PUSH(MF_SAIDA, q->size);
+    pthread_cond_broadcast(&q->c); pthread_mutex_unlock(&q->m);
 }
 static Evento filaEvento_pop(FilaEvento *q, volatile int *running){
     pthread_mutex_lock(&q->m);
-    while(q->size==0 && *running) pthread_cond_wait(&q->c,&q->m);
-    Evento ev={EVENTO,'?',-1,'?'}; if(q->size){ ev=q->buf[q->ini]; q->ini=(q->ini+1)%MAX_QUEUE; q->size--; }
+    if(q->size==0 && *running){
+        MET_T0(t); while(q->size==0 && *running) pthread_cond_wait(&q->c,&q->m);
+        MET_ESPERA(MF_SAIDA, MFC_POP_BLOQ, MH_POP(MF_SAIDA), t); }
+    Evento ev={EVENTO,'?',-1,'?'}; if(q->size){ ev=q->buf[q->ini]; q->ini=(q->ini+1)%MAX_QUEUE; q->size--; MET_POP(MF_SAIDA); }
     pthread_cond_broadcast(&q->c); pthread_mutex_unlock(&q->m); return ev; }
 
-//fila para mensagens recebidas (ordem de chegada)
+//fila para mensagens recebidas (ordem de chegada); só o ponteiro para o buffer do pool anda
 
 typedef struct {
-    Msg buf[MAX_QUEUE];
+    Msg *buf[MAX_QUEUE];
     int ini, fim, size;
     pthread_mutex_t m;
     pthread_cond_t c;
 } FilaMsg;
 
 static void filaMsg_init(FilaMsg *q){ q->ini=q->fim=q->size=0; pthread_mutex_init(&q->m,NULL); pthread_cond_init(&q->c,NULL);} 
-static void filaMsg_push(FilaMsg *q, Msg m){
+static void filaMsg_push(FilaMsg *q, Msg *m){
     pthread_mutex_lock(&q->m);
     while(q->size==MAX_QUEUE) pthread_cond_wait(&q->c,&q->m);
-    q->buf[q->fim]=m; q->fim=(q->fim+1)%MAX_QUEUE; q->size++; pthread_cond_broadcast(&q->c); pthread_mutex_unlock(&q->m);
+    q->buf[q->fim]=m; q->fim=(q->fim+1)%MAX_QUEUE; q->size++; MET_PUSH(MF_ENTRADA, q->size);
+    pthread_cond_broadcast(&q->c); pthread_mutex_unlock(&q->m);
 }
-static Msg filaMsg_pop(FilaMsg *q, volatile int *running){
+//retira sem esperar (depois de filaMsg_wait): NULL se outro worker levou a mensagem
+static Msg *filaMsg_tenta(FilaMsg *q){
     pthread_mutex_lock(&q->m);
-    while(q->size==0 && *running) pthread_cond_wait(&q->c,&q->m);
-    Msg m={0}; if(q->size){ m=q->buf[q->ini]; q->ini=(q->ini+1)%MAX_QUEUE; q->size--; }
+    Msg *m=NULL; if(q->size){ m=q->buf[q->ini]; q->ini=(q->ini+1)%MAX_QUEUE; q->size--; MET_POP(MF_ENTRADA); }
     pthread_cond_broadcast(&q->c); pthread_mutex_unlock(&q->m); return m; }
+//espera haver espaço (só a thread de entrada insere, então o push seguinte não bloqueia)
+static void filaMsg_wait_space(FilaMsg *q, volatile int *running){
+    pthread_mutex_lock(&q->m);
+    if(q->size==MAX_QUEUE && *running){
+        MET_T0(t); while(q->size==MAX_QUEUE && *running) pthread_cond_wait(&q->c,&q->m);
+        MET_ESPERA(MF_ENTRADA, MFC_PUSH_BLOQ, MH_PUSH(MF_ENTRADA), t); }
+    pthread_mutex_unlock(&q->m); }
+//espera haver mensagem sem retirá-la (o consumidor retira depois, sob o lock do snapshot)
+static int filaMsg_wait(FilaMsg *q, volatile int *running){
+    pthread_mutex_lock(&q->m);
+    if(q->size==0 && *running){
+        MET_T0(t); while(q->size==0 && *running) pthread_cond_wait(&q->c,&q->m);
+        MET_ESPERA(MF_ENTRADA, MFC_POP_BLOQ, MH_POP(MF_ENTRADA), t); }
+    int n=q->size; pthread_mutex_unlock(&q->m); return n>0; }
+//reprodução: a entrega segue o remetente gravado, não a ordem de chegada
+static int filaMsg_busca(const FilaMsg *q, int de){
+    for(int k=0;k<q->size;k++) if(q->buf[(q->ini+k)%MAX_QUEUE]->from==de) return k;
+    return -1; }
+static int filaMsg_wait_de(FilaMsg *q, int de, volatile int *running){
+    pthread_mutex_lock(&q->m);
+    while(filaMsg_busca(q,de)<0 && *running) pthread_cond_wait(&q->c,&q->m);
+    int ok=filaMsg_busca(q,de)>=0; pthread_mutex_unlock(&q->m); return ok; }
+//retira a primeira mensagem de 'de'; as anteriores avançam uma posição sem mudar de ordem
+static Msg *filaMsg_pop_de(FilaMsg *q, int de){
+    pthread_mutex_lock(&q->m);
+    int k=filaMsg_busca(q,de);
+    Msg *m=q->buf[(q->ini+k)%MAX_QUEUE];
+    for(;k>0;k--) q->buf[(q->ini+k)%MAX_QUEUE]=q->buf[(q->ini+k-1)%MAX_QUEUE];
+    q->ini=(q->ini+1)%MAX_QUEUE; q->size--; MET_POP(MF_ENTRADA);
+    pthread_cond_broadcast(&q->c); pthread_mutex_unlock(&q->m); return m; }
+
+//fila de envios sem trava (MPMC limitada, Vyukov): produtores quaisquer, consumidor = motor de progresso
+
+typedef struct {
+    int dest, tag, len;
+    void *heap; //payload maior que Msg (relatórios da árvore); NULL = usa 'm'
+    Msg m;
+} Envio;
+
+typedef struct {
+    atomic_size_t seq;
+    Envio e;
+} CelulaEnvio;
+
+typedef struct {
+    CelulaEnvio buf[MAX_SAIDA];
+    _Alignas(CACHE_LINE) atomic_size_t cauda; //próxima posição a inserir
+    _Alignas(CACHE_LINE) atomic_size_t cabeca; //próxima posição a retirar
+} FilaEnvio;
+
+static void filaEnvio_init(FilaEnvio *q){
+    for(size_t i=0;i<MAX_SAIDA;i++) atomic_init(&q->buf[i].seq, i);
+    atomic_init(&q->cauda, 0); atomic_init(&q->cabeca, 0);
+}
+//devolve 0 se cheia
+static int filaEnvio_push(FilaEnvio *q, const Envio *e){
+    size_t pos = atomic_load_explicit(&q->cauda, memory_order_relaxed);
+    for(;;){
+        CelulaEnvio *c = &q->buf[pos & (MAX_SAIDA-1)];
+        size_t seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+        if(dif == 0){
+            if(atomic_compare_exchange_weak_explicit(&q->cauda, &pos, pos+1, memory_order_relaxed, memory_order_relaxed)){
+                c->e = *e;
+                atomic_store_explicit(&c->seq, pos+1, memory_order_release);
+                return 1;
+            }
+        } else if(dif < 0) return 0;
+        else pos = atomic_load_explicit(&q->cauda, memory_order_relaxed);
+    }
+}
+//devolve 0 se vazia
+static int filaEnvio_pop(FilaEnvio *q, Envio *out){
+    size_t pos = atomic_load_explicit(&q->cabeca, memory_order_relaxed);
+    for(;;){
+        CelulaEnvio *c = &q->buf[pos & (MAX_SAIDA-1)];
+        size_t seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)(pos+1);
+        if(dif == 0){
+            if(atomic_compare_exchange_weak_explicit(&q->cabeca, &pos, pos+1, memory_order_relaxed, memory_order_relaxed)){
+                *out = c->e;
+                atomic_store_explicit(&c->seq, pos+MAX_SAIDA, memory_order_release);
+                return 1;
+            }
+        } else if(dif < 0) return 0;
+        else pos = atomic_load_explicit(&q->cabeca, memory_order_relaxed);
+    }
+}
+
+/* -------------------------------- Transporte ------------------------------- */
+
+typedef enum { RED_INT, RED_LONG, RED_DOUBLE } RedTipo;
+typedef enum { RED_SUM, RED_MAX } RedOp;
+
+//coletiva não bloqueante em andamento
+typedef struct { MPI_Request mpi; long seq; int *out; } Pedido;
+
+//o que a lógica de relógio/snapshot precisa da camada de comunicação
+typedef struct Transporte Transporte;
+struct Transporte {
+    const char *nome;
+    int rank;
+    void (*send)(Transporte *t, int dest, int tag, const void *buf, int len);
+    //não bloqueante: copia até 'max' bytes em 'buf' e devolve quantos (0 = nada chegou)
+    int (*recv)(Transporte *t, int tag, void *buf, int max);
+    //envio assíncrono para o motor de progresso; NULL quando 'send' já não bloqueia
+    void (*isend)(Transporte *t, int dest, int tag, const void *buf, int len, MPI_Request *req);
+    void (*iallmax)(Transporte *t, const int *in, int *out, Pedido *p);
+    void (*ibarrier)(Transporte *t, Pedido *p);
+    int (*test)(Transporte *t, Pedido *p);
+    //bloqueante; resultado só no rank 0
+    void (*reduce)(Transporte *t, const void *in, void *out, int n, RedTipo tipo, RedOp op);
+    void *priv;
+};
+
+/* MPI */
+
+static void mpi_send(Transporte *t, int dest, int tag, const void *buf, int len){
+    (void)t; MPI_Send((void*)buf, len, MPI_BYTE, dest, tag, MPI_COMM_WORLD);
+}
+static int mpi_recv(Transporte *t, int tag, void *buf, int max){
+    int flag=0; MPI_Status st; (void)t;
+    MPI_Iprobe(MPI_ANY_SOURCE, tag, MPI_COMM_WORLD, &flag, &st);
+    if(!flag) return 0;
+    int bytes=0; MPI_Get_count(&st, MPI_BYTE, &bytes);
+    if(bytes <= max){
+        MPI_Recv(buf, bytes, MPI_BYTE, st.MPI_SOURCE, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        return bytes;
+    }
+    //maior que o buffer: descarta o excesso
+    char *tmp = malloc(bytes);
+    MPI_Recv(tmp, bytes, MPI_BYTE, st.MPI_SOURCE, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    memcpy(buf, tmp, max); free(tmp);
+    return max;
+}
+static void mpi_isend(Transporte *t, int dest, int tag, const void *buf, int len, MPI_Request *req){
+    (void)t; MPI_Isend((void*)buf, len, MPI_BYTE, dest, tag, MPI_COMM_WORLD, req);
+}
+static void mpi_iallmax(Transporte *t, const int *in, int *out, Pedido *p){
+    (void)t; MPI_Iallreduce(in, out, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD, &p->mpi);
+}
+static void mpi_ibarrier(Transporte *t, Pedido *p){ (void)t; MPI_Ibarrier(MPI_COMM_WORLD, &p->mpi); }
+static int mpi_test(Transporte *t, Pedido *p){
+    int done=0; (void)t; MPI_Test(&p->mpi, &done, MPI_STATUS_IGNORE); return done;
+}
+static void mpi_reduce(Transporte *t, const void *in, void *out, int n, RedTipo tipo, RedOp op){
+    MPI_Datatype dt = tipo == RED_INT ? MPI_INT : tipo == RED_LONG ? MPI_LONG : MPI_DOUBLE;
+    (void)t; MPI_Reduce(in, out, n, dt, op == RED_SUM ? MPI_SUM : MPI_MAX, 0, MPI_COMM_WORLD);
+}
+
+static void transporte_mpi(Transporte *t){
+    *t = (Transporte){.nome="mpi", .send=mpi_send, .recv=mpi_recv, .isend=mpi_isend, .iallmax=mpi_iallmax,
+                      .ibarrier=mpi_ibarrier, .test=mpi_test, .reduce=mpi_reduce, .priv=NULL};
+    MPI_Comm_rank(MPI_COMM_WORLD, &t->rank);
+}
+
+/* Memória compartilhada: um anel SPSC por (tag, origem, destino); o payload grande vai por ponteiro */
+
+typedef struct {
+    _Alignas(CACHE_LINE) atomic_size_t cauda; //escrita só pela origem
+    _Alignas(CACHE_LINE) atomic_size_t cabeca; //escrita só pelo destino
+    Envio buf[SHM_ANEL];
+} AnelSpsc;
+
+typedef struct {
+    AnelSpsc aneis[2][NUM_PROC][NUM_PROC]; //[tag][origem][destino]
+    _Alignas(CACHE_LINE) atomic_long chegadas; //barreira por contagem: a k-ésima termina em k*NUM_PROC
+    int vals[2][NUM_PROC]; //allmax: buffer alternado por paridade da coletiva
+    char red[2][NUM_PROC][MAX_RED * sizeof(double)];
+} ShmMundo;
+
+typedef struct {
+    ShmMundo *w;
+    long seq; //coletivas feitas por este rank
+    int rr[2]; //próxima origem a examinar (rodízio entre canais)
+} ShmRank;
+
+static void shm_send(Transporte *t, int dest, int tag, const void *buf, int len){
+    ShmRank *r = t->priv;
+    AnelSpsc *a = &r->w->aneis[tag][t->rank][dest];
+    size_t cauda = atomic_load_explicit(&a->cauda, memory_order_relaxed);
+    while(cauda - atomic_load_explicit(&a->cabeca, memory_order_acquire) == SHM_ANEL) sched_yield();
+    Envio *e = &a->buf[cauda & (SHM_ANEL-1)];
+    e->dest = dest; e->tag = tag; e->len = len; e->heap = NULL;
+    if(len <= (int)sizeof(Msg)) memcpy(&e->m, buf, len);
+    else { e->heap = malloc(len); memcpy(e->heap, buf, len); }
+    atomic_store_explicit(&a->cauda, cauda+1, memory_order_release);
+}
+static int shm_recv(Transporte *t, int tag, void *buf, int max){
+    ShmRank *r = t->priv;
+    for(int k=0;k<NUM_PROC;k++){
+        int src = (r->rr[tag] + k) % NUM_PROC;
+        AnelSpsc *a = &r->w->aneis[tag][src][t->rank];
+        size_t cabeca = atomic_load_explicit(&a->cabeca, memory_order_relaxed);
+        if(cabeca == atomic_load_explicit(&a->cauda, memory_order_acquire)) continue;
+        Envio *e = &a->buf[cabeca & (SHM_ANEL-1)];
+        int n = e->len < max ? e->len : max;
+        memcpy(buf, e->heap ? e->heap : (void*)&e->m, n);
+        free(e->heap);
+        atomic_store_explicit(&a->cabeca, cabeca+1, memory_order_release);
+        r->rr[tag] = (src + 1) % NUM_PROC;
+        return n;
+    }
+    return 0;
+}
+static void shm_ibarrier(Transporte *t, Pedido *p){
+    ShmRank *r = t->priv;
+    p->seq = ++r->seq; p->out = NULL;
+    atomic_fetch_add(&r->w->chegadas, 1);
+}
+static void shm_iallmax(Transporte *t, const int *in, int *out, Pedido *p){
+    ShmRank *r = t->priv;
+    r->w->vals[(r->seq+1) & 1][t->rank] = *in;
+    shm_ibarrier(t, p);
+    p->out = out;
+}
+static int shm_test(Transporte *t, Pedido *p){
+    ShmRank *r = t->priv;
+    if(atomic_load(&r->w->chegadas) < p->seq * NUM_PROC) return 0;
+    if(p->out){
+        int *v = r->w->vals[p->seq & 1], m = v[0];
+        for(int i=1;i<NUM_PROC;i++) if(v[i] > m) m = v[i];
+        *p->out = m;
+    }
+    return 1;
+}
+static void shm_reduce(Transporte *t, const void *in, void *out, int n, RedTipo tipo, RedOp op){
+    ShmRank *r = t->priv;
+    size_t tam = tipo == RED_INT ? sizeof(int) : tipo == RED_LONG ? sizeof(long) : sizeof(double);
+    memcpy(r->w->red[(r->seq+1) & 1][t->rank], in, n * tam);
+    Pedido p; shm_ibarrier(t, &p);
+    while(!shm_test(t, &p)) sched_yield();
+    char (*red)[MAX_RED * sizeof(double)] = r->w->red[p.seq & 1];
+    for(int k=0;k<n && t->rank==0;k++){
+        if(tipo == RED_DOUBLE){
+            double a = ((double*)red[0])[k];
+            for(int i=1;i<NUM_PROC;i++){ double b = ((double*)red[i])[k]; a = op == RED_SUM ? a + b : (b > a ? b : a); }
+            ((double*)out)[k] = a;
+        } else if(tipo == RED_LONG){
+            long a = ((long*)red[0])[k];
+            for(int i=1;i<NUM_PROC;i++){ long b = ((long*)red[i])[k]; a = op == RED_SUM ? a + b : (b > a ? b : a); }
+            ((long*)out)[k] = a;
+        } else {
+            int a = ((int*)red[0])[k];
+            for(int i=1;i<NUM_PROC;i++){ int b = ((int*)red[i])[k]; a = op == RED_SUM ? a + b : (b > a ? b : a); }
+            ((int*)out)[k] = a;
+        }
+    }
+    //ninguém reescreve este buffer antes de o rank 0 terminar de lê-lo
+    shm_ibarrier(t, &p);
+    while(!shm_test(t, &p)) sched_yield();
+}
+
+static void transporte_shm(Transporte *t, ShmRank *r, int rank){
+    *t = (Transporte){.nome="shm", .rank=rank, .send=shm_send, .recv=shm_recv, .isend=NULL, .iallmax=shm_iallmax,
+                      .ibarrier=shm_ibarrier, .test=shm_test, .reduce=shm_reduce, .priv=r};
+}
 
 /* --------------------------- Snapshot Chandy-Lamport ----------------------- */
 
+typedef enum { SNAP_CL = 0, SNAP_LY = 1 } SnapModo;
+
+//custo de um snapshot em um processo
+typedef struct Custo {
+    double captura; //tempo gravando o estado local e enviando markers (s)
+    double fechamento; //corte -> último canal fechado (ida e volta dos markers) (s)
+    int msgs; //mensagens gravadas nos canais
+    int atrasados; //eventos da aplicação que esperaram pelo snapshot
+    double atraso; //tempo total dessas esperas (s)
+    int bytes; //enviados pelo snapshot: markers, MSG_LY_CTRL, MSG_FIM e relatórios da coleta
+} Custo;
+
+//estado de um processo no corte, como viaja na árvore de coleta
+typedef struct Fragmento {
+    int pid;
+    Clock local;
+    int channel_counts[NUM_PROC];
+    char channel_labels[NUM_PROC][MAX_QUEUE];
+} Fragmento;
+
 typedef struct Snapshot {
     int active; //snapshot em andamento?
+    int epoch; //número do último corte feito (cor corrente em Lai-Yang)
+    int root; //iniciador da época corrente
     Clock local; //estado local gravado
-    int marker_recv[NUM_PROC]; //para cada canal de entrada, recebi marker?
+    int marker_recv[NUM_PROC]; //para cada canal de entrada, recebi marker? (LY: canal concluído?)
     char channel_labels[NUM_PROC][MAX_QUEUE];
     int channel_counts[NUM_PROC];
+    //Lai-Yang: contadores por canal
+    int sent[NUM_PROC]; //enviadas para j na época corrente
+    int cut_sent[NUM_PROC]; //enviadas para j na época anterior ao último corte
+    int recv[NUM_PROC]; //recebidas de i com a cor da época corrente
+    int recv_cut[NUM_PROC]; //recebidas de i com a cor da época anterior (antes e depois do corte)
+    int expected[NUM_PROC]; //cut_sent informado por i (-1 = ainda desconhecido)
+    int informed[NUM_PROC]; //j já recebeu de mim algo com a cor corrente?
+    int flush_pending; //ainda há canal de saída sem mensagem vermelha (vale mesmo após concluir)
+    //estatísticas
+    double t_cut; //agora() do corte local
+    int ctrl_sent; //markers, MSG_LY_CTRL, MSG_FIM ou relatórios enviados
+    int completed; //snapshots concluídos neste processo
+    double t_max; //maior tempo corte->conclusão (s)
+    Custo custo[MAX_SNAPS]; //indexado pela época
+    //coleta em árvore (-g)
+    int gather_open; //aguardando fragmento local e/ou relatórios dos filhos
+    int local_done;
+    int children_pending;
+    int gathered; //fragmentos em 'frags'
+    Fragmento frags[NUM_PROC];
+    //sem -g, no iniciador: processos que ainda não avisaram a conclusão da época
+    int fins_pendentes;
     pthread_mutex_t m;
 } Snapshot;
 
 static void snapshot_init(Snapshot *s){
-    s->active=0; memset(&s->local,0,sizeof(Clock)); memset(s->marker_recv,0,sizeof(s->marker_recv));
+    s->active=0; s->epoch=0; memset(&s->local,0,sizeof(Clock)); memset(s->marker_recv,0,sizeof(s->marker_recv));
     memset(s->channel_labels,0,sizeof(s->channel_labels)); memset(s->channel_counts,0,sizeof(s->channel_counts));
+    memset(s->sent,0,sizeof(s->sent)); memset(s->cut_sent,0,sizeof(s->cut_sent));
+    memset(s->recv,0,sizeof(s->recv)); memset(s->recv_cut,0,sizeof(s->recv_cut));
+    memset(s->expected,0,sizeof(s->expected)); memset(s->informed,0,sizeof(s->informed));
+    s->t_cut=0; s->ctrl_sent=0; s->completed=0; s->t_max=0; memset(s->custo,0,sizeof(s->custo));
+    s->flush_pending=0; s->root=0; s->gather_open=0; s->local_done=0; s->children_pending=0; s->gathered=0;
+    s->fins_pendentes=0;
     pthread_mutex_init(&s->m,NULL);
 }
 
@@ -116,171 +505,523 @@ static void snapshot_init(Snapshot *s){
 
 typedef struct Contexto {
     int pid;
+    Transporte *tr;
     Clock clock;
     FilaMsg inbox; //mensagens recebidas (para RECEBIMENTO)
+    Pool pool; //buffers de Msg: a recepção pega, threadRelogio devolve após a entrega
+    Msg *rx; //buffer da próxima recepção (marker e controle o reaproveitam)
     FilaEvento outbox; //pedidos de ENVIO vindos da timeline
     volatile int running;
+    SnapModo modo;
+    int flush_ms; //LY: espera antes de MSG_LY_CTRL para canais ociosos
+    int gather; //-g: coleta o corte global no iniciador
+    //agendador de snapshots (P0)
+    int period_ms, jitter_ms, every_k, max_snaps;
+    int app_events; //eventos da aplicação desde o último disparo
+    int scheduled, skipped;
+    int app_done;
+    pthread_mutex_t sched_m;
+    pthread_cond_t sched_c;
+    //motor de progresso (-p)
+    int progress;
+    volatile int rel_done;
+    FilaEnvio saida;
+    Envio inflight[MAX_INFLIGHT];
+    MPI_Request inflight_req[MAX_INFLIGHT];
+    int inflight_n;
+    //medição de mensagens da aplicação (só a thread de recepção escreve)
+    long app_msgs;
+    double lat_sum;
+    double t_app; //duração da fase da aplicação (s)
     Snapshot snap;
+    Fragmento rep_buf[NUM_PROC]; //relatório recebido de um filho da árvore
+    Fragmento global_buf[NUM_PROC]; //corte global montado na raiz
+    Carga carga; //linha do tempo da aplicação
+    int quiet;
+    //-w workers de aplicação: consomem 'lista' pelo índice compartilhado 'proximo'
+    int workers;
+    long trabalho_ns; //-u
+    Evento *lista;
+    long count;
+    //grafo de comunicação tirado da lista: LY só espera e só avisa canais que existem
+    int origem[NUM_PROC], destino[NUM_PROC];
+    atomic_long proximo;
+    atomic_int ativos; //workers ainda na linha do tempo
+    atomic_int disparado; //snapshot fixo do primeiro evento interno de P0
+    Gravacao grav; //-r/-y: passos da entrada própria do relógio
+    pthread_cond_t vez; //reprodução: sinalizado (sob snap.m) a cada passo
 } Contexto;
 
-/* --------------------------------- Registro -------------------------------- */
+typedef struct Worker {
+    Contexto *ctx;
+    int id;
+} Worker;
 
-static void printClock(int pid, Clock *clock, char label, TipoEvento tipo, char secondLabel) {
-    switch (tipo) {
-        case EVENTO:
-            printf("P%d|%c (%d, %d, %d) evento interno\n", pid, label, clock->p[0], clock->p[1], clock->p[2]);
-            break;
-        case ENVIO:
-            printf("P%d|%c (%d, %d, %d) envio para %c\n", pid, label, clock->p[0], clock->p[1], clock->p[2], secondLabel);
-            break;
-        case RECEBIMENTO:
-            printf("P%d|%c (%d, %d, %d) recebido de %c\n", pid, label, clock->p[0], clock->p[1], clock->p[2], secondLabel);
-            break;
+/* ---------------------------- MPI send recv -------------------------------- */
+
+//com -p só enfileira; o motor de progresso faz o MPI_Isend na ordem da fila
+static void transmit(Contexto *ctx, int dest, int tag, const void *buf, int len){
+    if(!ctx->progress){
+        ctx->tr->send(ctx->tr, dest, tag, buf, len);
+        return;
     }
-    fflush(stdout);
+    Envio e = {.dest=dest, .tag=tag, .len=len, .heap=NULL};
+    if(len <= (int)sizeof(Msg)) memcpy(&e.m, buf, len);
+    else { e.heap = malloc(len); memcpy(e.heap, buf, len); }
+    while(!filaEnvio_push(&ctx->saida, &e)) sched_yield();
 }
 
-/* ---------------------------- MPI send recv -------------------------------- */
+static void send_msg(Contexto *ctx, const Msg *m){
+    transmit(ctx, m->to, TAG_APP, m, sizeof(Msg));
+}
 
-static void send_msg(const Msg *m){
-    MPI_Send((void*)m, sizeof(Msg), MPI_BYTE, m->to, 0, MPI_COMM_WORLD);
+//motor de progresso: conclui Isends e inicia os próximos da fila; devolve quanto trabalho fez
+static int progress_sends(Contexto *ctx){
+    int work = 0;
+    if(!ctx->tr->isend){
+        //transporte cujo envio não bloqueia: esvazia a fila direto
+        Envio e;
+        while(filaEnvio_pop(&ctx->saida, &e)){
+            ctx->tr->send(ctx->tr, e.dest, e.tag, e.heap ? e.heap : (void*)&e.m, e.len);
+            free(e.heap);
+            work++;
+        }
+        return work;
+    }
+    if(ctx->inflight_n > 0){
+        int idx[MAX_INFLIGHT], n = 0;
+        MPI_Testsome(MAX_INFLIGHT, ctx->inflight_req, &n, idx, MPI_STATUSES_IGNORE);
+        for(int k=0;k<n && n!=MPI_UNDEFINED;k++){
+            free(ctx->inflight[idx[k]].heap);
+            ctx->inflight[idx[k]].heap = NULL;
+            ctx->inflight_n--;
+            work++;
+        }
+    }
+    for(int slot=0; slot<MAX_INFLIGHT && ctx->inflight_n<MAX_INFLIGHT; slot++){
+        if(ctx->inflight_req[slot] != MPI_REQUEST_NULL) continue;
+        Envio *e = &ctx->inflight[slot];
+        if(!filaEnvio_pop(&ctx->saida, e)) break;
+        ctx->tr->isend(ctx->tr, e->dest, e->tag, e->heap ? e->heap : (void*)&e->m, e->len, &ctx->inflight_req[slot]);
+        ctx->inflight_n++;
+        work++;
+    }
+    return work;
 }
 
-static int recv_msg(int *src_opt, Msg *out, MPI_Status *status){
-    int flag=0; MPI_Iprobe(src_opt?*src_opt:MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &flag, status);
-    if(!flag) return 0;
-    MPI_Recv(out, sizeof(Msg), MPI_BYTE, status->MPI_SOURCE, 0, MPI_COMM_WORLD, status);
-    return 1;
+//fila de envios vazia e nenhum Isend pendente
+static int progress_idle(Contexto *ctx){
+    return !ctx->progress || (ctx->inflight_n == 0 &&
+           atomic_load(&ctx->saida.cabeca) == atomic_load(&ctx->saida.cauda));
 }
 
-/* ------------------------------ Threads ------------------------------------ */
+static int recv_msg(Contexto *ctx, Msg *out){
+    return ctx->tr->recv(ctx->tr, TAG_APP, out, sizeof(Msg)) > 0;
+}
 
-static void start_snapshot(Contexto *ctx){
-    pthread_mutex_lock(&ctx->snap.m);
+//relatório de um filho da árvore: 1..N fragmentos; devolve quantos foram lidos
+static int recv_report(Contexto *ctx, Fragmento *out, int max){
+    return ctx->tr->recv(ctx->tr, TAG_REPORT, out, max * (int)sizeof(Fragmento)) / (int)sizeof(Fragmento);
+}
 
-    if(ctx->snap.active){ 
-        pthread_mutex_unlock(&ctx->snap.m); 
-        return; 
-    }
+/* ------------------------------ Snapshot ----------------------------------- */
 
-    //aguarda que a fila de recebimento esteja vazia antes de salvar estado local
-    while(ctx->inbox.size > 0){
-        pthread_mutex_unlock(&ctx->snap.m);
-        usleep(1000);
-        pthread_mutex_lock(&ctx->snap.m);
-    }
+//as funções abaixo assumem ctx->snap.m travado
 
-    //inicia snapshot
+//envio de controle do snapshot: contado em mensagens e em bytes de fato transmitidos
+static void envia_controle(Contexto *ctx, int dest, int tag, const void *buf, int len){
+    transmit(ctx, dest, tag, buf, len);
+    ctx->snap.ctrl_sent++;
+    if(ctx->snap.epoch < MAX_SNAPS) ctx->snap.custo[ctx->snap.epoch].bytes += len;
+}
+
+/* Árvore de coleta: posições relativas ao iniciador, heap binário (filhos 2r+1 e 2r+2) */
+
+static int tree_rel(const Contexto *ctx){ return (ctx->pid - ctx->snap.root + NUM_PROC) % NUM_PROC; }
+static int tree_abs(const Contexto *ctx, int rel){ return (rel + ctx->snap.root) % NUM_PROC; }
+
+static int tree_children(const Contexto *ctx){
+    int r = tree_rel(ctx), n = 0;
+    if(2*r+1 < NUM_PROC) n++;
+    if(2*r+2 < NUM_PROC) n++;
+    return n;
+}
+
+static int tree_depth(void){
+    int d = 0;
+    while((2 << d) - 1 < NUM_PROC) d++;
+    return d;
+}
+
+//grava o estado local e abre a época 'epoch' do iniciador 'root'; 'from' é o canal que disparou o corte (-1 no iniciador)
+static void snapshot_cut(Contexto *ctx, int epoch, int root, int from){
+    double t0 = agora();
     ctx->snap.active = 1;
-    ctx->snap.local = ctx->clock; 
+    ctx->snap.epoch = epoch;
+    ctx->snap.root = root;
+    ctx->snap.local = ctx->clock;
+    ctx->snap.t_cut = agora();
+    ctx->snap.flush_pending = (ctx->modo == SNAP_LY);
+
     for(int i=0;i<NUM_PROC;i++){
-        ctx->snap.marker_recv[i] = (i == ctx->pid);
+        ctx->snap.marker_recv[i] = (i == from || i == ctx->pid);
         ctx->snap.channel_counts[i] = 0;
-        memset(ctx->snap.channel_labels[i], 0, MAX_QUEUE); // limpa canais
+        memset(ctx->snap.channel_labels[i], 0, MAX_QUEUE);
+        //Lai-Yang: fecha os contadores da época anterior
+        ctx->snap.cut_sent[i] = ctx->snap.sent[i];   ctx->snap.sent[i] = 0;
+        ctx->snap.recv_cut[i] = ctx->snap.recv[i];   ctx->snap.recv[i] = 0;
+        ctx->snap.expected[i] = -1;
+        ctx->snap.informed[i] = 0;
+    }
+
+    //mensagens já recebidas mas ainda não entregues à aplicação não estão no estado local: estão no canal
+    pthread_mutex_lock(&ctx->inbox.m);
+    for(int k=0, i=ctx->inbox.ini; k<ctx->inbox.size; k++, i=(i+1)%MAX_QUEUE){
+        const Msg *m = ctx->inbox.buf[i];
+        int c = ctx->snap.channel_counts[m->from];
+        if(c < MAX_QUEUE){ ctx->snap.channel_labels[m->from][c] = m->label; ctx->snap.channel_counts[m->from]++; }
+    }
+    pthread_mutex_unlock(&ctx->inbox.m);
+
+    Custo *c = epoch < MAX_SNAPS ? &ctx->snap.custo[epoch] : NULL;
+
+    if(ctx->gather){
+        ctx->snap.gather_open = 1;
+        ctx->snap.local_done = 0;
+        ctx->snap.gathered = 0;
+        ctx->snap.children_pending = tree_children(ctx);
+    } else if(root == ctx->pid){
+        ctx->snap.fins_pendentes = NUM_PROC - 1;
+    }
+
+    if(ctx->modo == SNAP_CL){
+        //envia markers para todos os outros processos
+        for(int p=0;p<NUM_PROC;p++){
+            if(p != ctx->pid){
+                Msg mk = {.type=MSG_MARKER, .from=ctx->pid, .to=p, .color=epoch, .root=root, .label='M'};
+                envia_controle(ctx, p, TAG_APP, &mk, sizeof(Msg));
+            }
+        }
     }
 
-    //envia markers para todos os outros processos
+    if(c) c->captura = agora() - t0;
+    if(trace_ativo) trace_fatia(TRACE_SNAPSHOT, "captura", (uint64_t)(t0 * 1e9), trace_ns(), 0, 0, ctx->snap.local.p, NUM_PROC);
+}
+
+//LY: envia MSG_LY_CTRL aos canais que ainda não receberam nada com a cor corrente
+static void snapshot_flush(Contexto *ctx){
+    if(!ctx->snap.flush_pending) return;
     for(int p=0;p<NUM_PROC;p++){
-        if(p != ctx->pid){
-            Msg mk = {.type = MSG_MARKER, .from = ctx->pid, .to = p, .label='M'};
-            send_msg(&mk);
+        if(p == ctx->pid || ctx->snap.informed[p] || !ctx->destino[p]) continue;
+        Msg c = {.type=MSG_LY_CTRL, .from=ctx->pid, .to=p, .color=ctx->snap.epoch, .root=ctx->snap.root,
+                 .cut_sent=ctx->snap.cut_sent[p], .label='C'};
+        envia_controle(ctx, p, TAG_APP, &c, sizeof(Msg));
+        ctx->snap.informed[p] = 1;
+    }
+    ctx->snap.flush_pending = 0;
+}
+
+static void printFragmento(const Fragmento *f){
+    printf("Local: "); vclock_print_vec(f->local.p, NUM_PROC); putchar('\n');
+    for(int p=0;p<NUM_PROC;p++){
+        if(p == f->pid) continue;
+        printf("Canal %d->%d: ", p, f->pid);
+        int n = f->channel_counts[p];
+        if(n == 0) printf("<vazio>\n");
+        else {
+            for(int i=0;i<n;i++) putchar(f->channel_labels[p][i]);
+            putchar('\n');
         }
     }
+}
 
-    pthread_mutex_unlock(&ctx->snap.m);
+//corte consistente sse nenhum processo j viu de i mais eventos do que i registrou: local_i.p[i] >= local_j.p[i]
+static int corte_consistente(const Fragmento *frags){
+    int maxv[NUM_PROC];
+    memcpy(maxv, frags[0].local.p, sizeof(maxv));
+    //laço interno contíguo em i: o compilador vetoriza o max por coluna
+    for(int j=1;j<NUM_PROC;j++)
+        for(int i=0;i<NUM_PROC;i++)
+            maxv[i] = frags[j].local.p[i] > maxv[i] ? frags[j].local.p[i] : maxv[i];
+    int ok = 1;
+    for(int i=0;i<NUM_PROC;i++) ok &= frags[i].local.p[i] >= maxv[i];
+    return ok;
 }
 
-static void *threadEntrada(void *arg){
-    Contexto *ctx = (Contexto*)arg;
+//envia ao pai o que foi coletado, ou monta o corte global na raiz
+static void gather_try_report(Contexto *ctx){
+    if(!ctx->snap.gather_open || !ctx->snap.local_done || ctx->snap.children_pending > 0) return;
 
-    while(ctx->running){
-        MPI_Status st; 
-        Msg m;
+    int rel = tree_rel(ctx);
+    if(rel != 0){
+        int parent = tree_abs(ctx, (rel-1)/2);
+        envia_controle(ctx, parent, TAG_REPORT, ctx->snap.frags, ctx->snap.gathered * (int)sizeof(Fragmento));
+    } else {
+        //fragmentos chegam em qualquer ordem; indexa por pid
+        Fragmento *global = ctx->global_buf;
+        int seen[NUM_PROC] = {0};
+        for(int k=0;k<ctx->snap.gathered;k++){
+            global[ctx->snap.frags[k].pid] = ctx->snap.frags[k];
+            seen[ctx->snap.frags[k].pid] = 1;
+        }
+        int completo = 1;
+        for(int p=0;p<NUM_PROC;p++) completo &= seen[p];
 
-        if(!recv_msg(NULL, &m, &st)){ 
-            usleep(1000); 
-            continue; 
+        printf("\n=== SNAPSHOT GLOBAL %d (raiz P%d, profundidade %d, %.3f ms) ===\n",
+               ctx->snap.epoch, ctx->pid, tree_depth(), (agora() - ctx->snap.t_cut) * 1000.0);
+        for(int p=0;p<NUM_PROC;p++){
+            if(!seen[p]){ printf("-- P%d: <ausente>\n", p); continue; }
+            printf("-- P%d\n", p);
+            printFragmento(&global[p]);
         }
+        printf("Consistente: %s\n", completo && corte_consistente(global) ? "sim" : "NÃO");
+        printf("======================\n\n");
+        fflush(stdout);
+    }
+    ctx->snap.gather_open = 0;
+}
 
-        pthread_mutex_lock(&ctx->snap.m);
+static void snapshot_check_done(Contexto *ctx){
+    if(!ctx->snap.active) return;
 
-        if(m.type == MSG_MARKER){
-            int from = m.from;
-
-            if(!ctx->snap.active){
-                //espera que todas as mensagens antigas sejam processadas antes de salvar estado
-                while(ctx->inbox.size > 0){
-                    pthread_mutex_unlock(&ctx->snap.m);
-                    usleep(1000);
-                    pthread_mutex_lock(&ctx->snap.m);
-                }
-
-                //grava estado local ao receber o primeiro marker
-                ctx->snap.active = 1; 
-                ctx->snap.local = ctx->clock; 
-
-                for(int i=0;i<NUM_PROC;i++){
-                    ctx->snap.marker_recv[i] = (i == from);
-                    ctx->snap.channel_counts[i] = 0;
-                    memset(ctx->snap.channel_labels[i], 0, MAX_QUEUE);
-                }
-
-                //envia markers para todos os outros processos
-                for(int p=0;p<NUM_PROC;p++){
-                    if(p != ctx->pid){
-                        Msg mk = {.type=MSG_MARKER, .from=ctx->pid, .to=p, .label='M'};
-                        send_msg(&mk);
-                    }
-                }
-            } else {
-                ctx->snap.marker_recv[from] = 1;
-            }
+    //verifica se todos os canais de entrada foram fechados
+    for(int p=0;p<NUM_PROC;p++){
+        if(p == ctx->pid) continue;
+        if(ctx->modo == SNAP_LY)
+            ctx->snap.marker_recv[p] = !ctx->origem[p] ||
+                                       (ctx->snap.expected[p] >= 0 && ctx->snap.recv_cut[p] >= ctx->snap.expected[p]);
+        if(!ctx->snap.marker_recv[p]) return;
+    }
 
-            //verifica se todos os markers chegaram
-            int done = 1;
-            for(int p=0;p<NUM_PROC;p++){
-                if(p == ctx->pid) continue;
-                if(!ctx->snap.marker_recv[p]){ done=0; break; }
-            }
+    double dt = agora() - ctx->snap.t_cut;
+    if(dt > ctx->snap.t_max) ctx->snap.t_max = dt;
+    ctx->snap.completed++;
+    MET_CONTA(MC_SNAP); MET_VALOR(MH_SNAP, dt * 1e9);
+    if(trace_ativo) trace_fatia(TRACE_SNAPSHOT, "fechamento", (uint64_t)(ctx->snap.t_cut * 1e9), trace_ns(), 0, 0, NULL, 0);
+    if(ctx->snap.epoch < MAX_SNAPS){
+        Custo *c = &ctx->snap.custo[ctx->snap.epoch];
+        c->fechamento = dt;
+        for(int p=0;p<NUM_PROC;p++) c->msgs += ctx->snap.channel_counts[p];
+    }
 
-            if(done){
-                printf("\n=== SNAPSHOT em P%d ===\n", ctx->pid);
-                printf("Local: (%d,%d,%d)\n", ctx->snap.local.p[0], ctx->snap.local.p[1], ctx->snap.local.p[2]);
-                for(int p=0;p<NUM_PROC;p++){
-                    if(p == ctx->pid) continue;
-                    printf("Canal %d->%d: ", p, ctx->pid);
-                    int n = ctx->snap.channel_counts[p];
-                    if(n == 0) printf("<vazio>\n");
-                    else {
-                        for(int i=0;i<n;i++) putchar(ctx->snap.channel_labels[p][i]);
-                        putchar('\n');
-                    }
-                }
-                printf("======================\n\n");
-
-                //reseta snapshot para permitir outro disparo
-                ctx->snap.active = 0; 
-                memset(ctx->snap.marker_recv, 0, sizeof(ctx->snap.marker_recv));
-                memset(ctx->snap.channel_counts, 0, sizeof(ctx->snap.channel_counts));
-                for(int p=0;p<NUM_PROC;p++) memset(ctx->snap.channel_labels[p], 0, MAX_QUEUE);
-            }
+    Fragmento f = {.pid=ctx->pid, .local=ctx->snap.local};
+    memcpy(f.channel_counts, ctx->snap.channel_counts, sizeof(f.channel_counts));
+    memcpy(f.channel_labels, ctx->snap.channel_labels, sizeof(f.channel_labels));
 
+    if(ctx->gather){
+        ctx->snap.frags[ctx->snap.gathered++] = f;
+        ctx->snap.local_done = 1;
+        gather_try_report(ctx);
+    } else {
+        printf("\n=== SNAPSHOT %d em P%d ===\n", ctx->snap.epoch, ctx->pid);
+        printFragmento(&f);
+        printf("======================\n\n");
+        fflush(stdout);
+        if(ctx->snap.root != ctx->pid){
+            Msg fim = {.type=MSG_FIM, .from=ctx->pid, .to=ctx->snap.root, .color=ctx->snap.epoch,
+                       .root=ctx->snap.root, .label='F'};
+            envia_controle(ctx, fim.to, TAG_APP, &fim, sizeof(Msg));
+        }
+    }
+
+    //reseta snapshot para permitir outro disparo
+    ctx->snap.active = 0;
+    memset(ctx->snap.marker_recv, 0, sizeof(ctx->snap.marker_recv));
+    memset(ctx->snap.channel_counts, 0, sizeof(ctx->snap.channel_counts));
+    for(int p=0;p<NUM_PROC;p++) memset(ctx->snap.channel_labels[p], 0, MAX_QUEUE);
+}
+
+//relatório de um filho: acumula e tenta subir
+static void on_report(Contexto *ctx, const Fragmento *in, int n){
+    for(int k=0;k<n && ctx->snap.gathered<NUM_PROC;k++)
+        ctx->snap.frags[ctx->snap.gathered++] = in[k];
+    ctx->snap.children_pending--;
+    gather_try_report(ctx);
+}
+
+//grava mensagem normal como em trânsito no canal 'from'
+static void snapshot_record(Contexto *ctx, int from, char label){
+    int k = ctx->snap.channel_counts[from];
+    if(k < MAX_QUEUE){
+        ctx->snap.channel_labels[from][k] = label;
+        ctx->snap.channel_counts[from]++;
+    }
+}
+
+//conclusão da época por todos: -g pela coleta na raiz, sem -g pelos MSG_FIM no iniciador
+static int snapshot_pendente(const Contexto *ctx){
+    return ctx->snap.active || ctx->snap.gather_open || ctx->snap.fins_pendentes > 0;
+}
+
+//devolve 0 se o snapshot anterior ainda está em andamento em algum processo: um marker
+//da época seguinte não pode alcançar quem ainda está na anterior
+static int start_snapshot(Contexto *ctx){
+    pthread_mutex_lock(&ctx->snap.m);
+
+    if(snapshot_pendente(ctx)){ 
+        pthread_mutex_unlock(&ctx->snap.m); 
+        return 0; 
+    }
+
+    //inicia snapshot
+    snapshot_cut(ctx, ctx->snap.epoch + 1, ctx->pid, -1);
+    snapshot_check_done(ctx);
+
+    pthread_mutex_unlock(&ctx->snap.m);
+    return 1;
+}
+
+//trava do snapshot pelo lado da aplicação: contabiliza a espera se houver disputa
+static void snap_lock_app(Contexto *ctx){
+    if(pthread_mutex_trylock(&ctx->snap.m) == 0) return;
+    double t0 = agora();
+    pthread_mutex_lock(&ctx->snap.m);
+    if(ctx->snap.epoch > 0 && ctx->snap.epoch < MAX_SNAPS){
+        Custo *c = &ctx->snap.custo[ctx->snap.epoch];
+        c->atrasados++;
+        c->atraso += agora() - t0;
+    }
+}
+
+//reprodução: com snap.m travado, espera o relógio chegar ao passo k da gravação
+static void vez_espera(Contexto *ctx, long k){
+    if(ctx->grav.modo != GRAV_REPRODUZ) return;
+    while(ctx->clock.p[ctx->pid] < k) pthread_cond_wait(&ctx->vez, &ctx->snap.m);
+}
+
+//depois de avançar a entrada própria, ainda com snap.m travado
+static void vez_passou(Contexto *ctx, int passo){
+    grav_anota(&ctx->grav, passo);
+    if(ctx->grav.modo == GRAV_REPRODUZ) pthread_cond_broadcast(&ctx->vez);
+}
+
+//iniciador sem -g: mais um processo concluiu a época corrente
+static void on_fim(Contexto *ctx, const Msg *m){
+    if(m->color == ctx->snap.epoch && ctx->snap.fins_pendentes > 0) ctx->snap.fins_pendentes--;
+}
+
+//CL: marker fecha o canal; o primeiro marker de uma época dispara o corte
+static void on_marker(Contexto *ctx, const Msg *m){
+    if(m->color > ctx->snap.epoch){
+        //start_snapshot só abre uma época depois que todos concluíram a anterior
+        if(ctx->snap.active)
+            fprintf(stderr, "P%d: snapshot %d abandonado pela época %d\n", ctx->pid, ctx->snap.epoch, m->color);
+        //grava estado local ao receber o primeiro marker
+        snapshot_cut(ctx, m->color, m->root, m->from);
+    } else if(ctx->snap.active && m->color == ctx->snap.epoch){
+        ctx->snap.marker_recv[m->from] = 1;
+    }
+    snapshot_check_done(ctx);
+}
+
+//LY: classifica pela cor; devolve 1 se a mensagem deve ir para a aplicação
+static int on_colored(Contexto *ctx, const Msg *m){
+    int from = m->from;
+
+    //mensagem vermelha de época nova: corta antes de entregar
+    if(m->color > ctx->snap.epoch){
+        if(ctx->snap.active)
+            fprintf(stderr, "P%d: snapshot %d abandonado pela época %d\n", ctx->pid, ctx->snap.epoch, m->color);
+        snapshot_cut(ctx, m->color, m->root, -1);
+    }
+
+    if(m->color == ctx->snap.epoch){
+        if(ctx->snap.expected[from] < 0) ctx->snap.expected[from] = m->cut_sent;
+        if(m->type == MSG_NORMAL) ctx->snap.recv[from]++;
+    } else if(m->color == ctx->snap.epoch - 1 && m->type == MSG_NORMAL){
+        //branca recebida depois do corte: estava no canal
+        ctx->snap.recv_cut[from]++;
+        if(ctx->snap.active) snapshot_record(ctx, from, m->label);
+    }
+
+    snapshot_check_done(ctx);
+    return m->type == MSG_NORMAL;
+}
+
+/* ------------------------------ Threads ------------------------------------ */
+
+//uma rodada de recepção (e, com -p, de envios); devolve 0 se não havia nada a fazer
+static int progress_poll(Contexto *ctx){
+    //filhos na árvore de coleta; cabe o pior caso (todos os fragmentos)
+    Fragmento *rep = ctx->rep_buf;
+
+    int work = ctx->progress ? progress_sends(ctx) : 0;
+
+    if(ctx->gather){
+        int n = recv_report(ctx, rep, NUM_PROC);
+        if(n > 0){
+            pthread_mutex_lock(&ctx->snap.m);
+            on_report(ctx, rep, n);
             pthread_mutex_unlock(&ctx->snap.m);
-            continue; //marker não vai para aplicação
-        } else {
-            //mensagem normal: se snapshot ativo e canal ainda não recebeu marker, grava como em trânsito
-            if(ctx->snap.active && !ctx->snap.marker_recv[m.from]){
-                int k = ctx->snap.channel_counts[m.from];
-                if(k < MAX_QUEUE){ 
-                    ctx->snap.channel_labels[m.from][k] = m.label; 
-                    ctx->snap.channel_counts[m.from]++; 
-                }
-            }
-            pthread_mutex_unlock(&ctx->snap.m);
+            return 1;
+        }
+    }
 
-            //encaminha mensagem para fila de entrega à aplicação
-            filaMsg_push(&ctx->inbox, m);
+    //a recepção cai direto no buffer do pool; pool vazio = a aplicação ainda não devolveu, tenta depois
+    if(!ctx->rx) ctx->rx = pool_pega(&ctx->pool);
+    Msg *m = ctx->rx;
+    if(!m || !recv_msg(ctx, m)){ 
+        //LY: canais que ficaram sem mensagem vermelha recebem um único controle
+        if(ctx->snap.flush_pending &&
+           (agora() - ctx->snap.t_cut) * 1000.0 >= ctx->flush_ms){
+            pthread_mutex_lock(&ctx->snap.m);
+            snapshot_flush(ctx);
+            pthread_mutex_unlock(&ctx->snap.m);
         }
+        return work;
+    }
+
+    uint64_t t0 = trace_ativo ? trace_ns() : 0;
+    int tipo = m->type; char label = m->label;
+    if(tipo == MSG_NORMAL){
+        ctx->app_msgs++;
+        ctx->lat_sum += agora() - m->t_envio;
+        MET_CONTA(MC_MSG_REC); MET_VALOR(MH_ENTREGA, (agora() - m->t_envio) * 1e9);
+    }
+
+    //classificação e entrega atômicas em relação ao corte
+    filaMsg_wait_space(&ctx->inbox, &ctx->running);
+    pthread_mutex_lock(&ctx->snap.m);
+
+    int deliver;
+    if(m->type == MSG_FIM){
+        on_fim(ctx, m);
+        deliver = 0;
+    } else if(ctx->modo == SNAP_LY){
+        deliver = on_colored(ctx, m);
+    } else if(m->type == MSG_MARKER){
+        on_marker(ctx, m);
+        deliver = 0; //marker não vai para aplicação
+    } else {
+        //mensagem normal: se snapshot ativo e canal ainda não recebeu marker, grava como em trânsito
+        if(ctx->snap.active && !ctx->snap.marker_recv[m->from])
+            snapshot_record(ctx, m->from, m->label);
+        deliver = 1;
+    }
+
+    //encaminha o buffer para a fila de entrega à aplicação; a partir daqui ele é de threadRelogio
+    if(deliver){ filaMsg_push(&ctx->inbox, m); ctx->rx = NULL; }
+    pthread_mutex_unlock(&ctx->snap.m);
+    if(trace_ativo) trace_fatia(-1, tipo == MSG_NORMAL ? "chegada" : "controle", t0, trace_ns(), label, 0, NULL, 0);
+    return 1;
+}
+
+//espera ociosa entre rodadas: o motor de progresso cede a CPU algumas vezes antes de dormir 50 us,
+//a thread de entrada dorme 1 ms
+static void progress_idle_wait(Contexto *ctx, int *ocioso){
+    if(!ctx->progress) usleep(1000);
+    else if(++*ocioso < 64) sched_yield();
+    else usleep(50);
+}
+
+static void *threadEntrada(void *arg){
+    Contexto *ctx = (Contexto*)arg;
+    trace_thread(ctx->pid, TRACE_ENTRADA, "threadEntrada");
+
+    int ocioso = 0;
+    while(ctx->running){
+        if(progress_poll(ctx)) ocioso = 0;
+        else progress_idle_wait(ctx, &ocioso);
     }
 
     return NULL;
@@ -288,91 +1029,427 @@ static void *threadEntrada(void *arg){
 
 static void *threadSaida(void *arg){
     Contexto *ctx=(Contexto*)arg;
+    trace_thread(ctx->pid, TRACE_SAIDA, "threadSaida");
+    long passo = 0; //próximo envio na gravação
     while(ctx->running){
         Evento ev = filaEvento_pop(&ctx->outbox, &ctx->running);
         if(!ctx->running) break;
         if(ev.tipo!=ENVIO) continue;
+        int to = ev.destino_ou_origem;
+        uint64_t t0 = trace_ativo ? trace_ns() : 0;
+        //relógio, cor e contadores são atualizados e o envio feito sem que um corte se intercale
+        snap_lock_app(ctx);
+        passo = grav_proximo(&ctx->grav, passo, GRAV_BIT(ENVIO));
+        vez_espera(ctx, passo++);
         ctx->clock.p[ctx->pid]++;
-        Msg m={.type=MSG_NORMAL,.from=ctx->pid,.to=ev.destino_ou_origem,.label=ev.label};
+        vez_passou(ctx, GRAV_ENVIO);
+        Msg m={.type=MSG_NORMAL,.from=ctx->pid,.to=to,.label=ev.label};
         m.clock = ctx->clock;
-        send_msg(&m);
-        printClock(ctx->pid, &ctx->clock, ev.label, ENVIO, ev.outroLabel);
+        m.color = ctx->snap.epoch;
+        m.root = ctx->snap.root;
+        m.cut_sent = ctx->snap.cut_sent[to];
+        ctx->snap.sent[to]++;
+        ctx->snap.informed[to] = 1;
+        m.t_envio = agora();
+        send_msg(ctx, &m);
+        pthread_mutex_unlock(&ctx->snap.m);
+        MET_CONTA(MC_MSG_ENV);
+        if(trace_ativo){
+            uint64_t t1 = trace_ns();
+            trace_fluxo('s', trace_id(ctx->pid, m.clock.p[ctx->pid]), t0 + (t1 - t0) / 2);
+            trace_fatia(-1, "envio", t0, t1, ev.label, ev.outroLabel, m.clock.p, NUM_PROC);
+        }
+        if(!ctx->quiet) Clock_print(ctx->pid, &m.clock, ev.label, ENVIO, ev.outroLabel);
+    }
+    return NULL;
+}
+
+//chamado pela aplicação a cada evento: acorda o agendador a cada K eventos
+static void sched_tick(Contexto *ctx){
+    if(ctx->pid != 0 || ctx->every_k <= 0) return;
+    pthread_mutex_lock(&ctx->sched_m);
+    if(++ctx->app_events >= ctx->every_k) pthread_cond_signal(&ctx->sched_c);
+    pthread_mutex_unlock(&ctx->sched_m);
+}
+
+static void *threadAgenda(void *arg){
+    Contexto *ctx=(Contexto*)arg;
+    trace_thread(ctx->pid, TRACE_AGENDA, "threadAgenda");
+    unsigned seed = 12345;
+
+    pthread_mutex_lock(&ctx->sched_m);
+    while(!ctx->app_done && ctx->scheduled < ctx->max_snaps){
+        if(ctx->period_ms > 0){
+            int ms = ctx->period_ms;
+            if(ctx->jitter_ms > 0) ms += (int)(rand_r(&seed) % (2*ctx->jitter_ms + 1)) - ctx->jitter_ms;
+            if(ms < 1) ms = 1;
+            struct timespec ts; clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += ms / 1000; ts.tv_nsec += (long)(ms % 1000) * 1000000L;
+            if(ts.tv_nsec >= 1000000000L){ ts.tv_sec++; ts.tv_nsec -= 1000000000L; }
+            int rc = 0;
+            while(!ctx->app_done && rc == 0 && !(ctx->every_k > 0 && ctx->app_events >= ctx->every_k))
+                rc = pthread_cond_timedwait(&ctx->sched_c, &ctx->sched_m, &ts);
+        } else {
+            while(!ctx->app_done && ctx->app_events < ctx->every_k)
+                pthread_cond_wait(&ctx->sched_c, &ctx->sched_m);
+        }
+        if(ctx->app_done) break;
+        ctx->app_events = 0;
+
+        pthread_mutex_unlock(&ctx->sched_m);
+        int ok = start_snapshot(ctx);
+        pthread_mutex_lock(&ctx->sched_m);
+        if(ok) ctx->scheduled++; else ctx->skipped++;
     }
+    pthread_mutex_unlock(&ctx->sched_m);
     return NULL;
 }
 
+//-u: trabalho da aplicação em cada evento, fora de qualquer trava (espera ativa)
+static void trabalho(long ns){
+    if(ns <= 0) return;
+    double fim = agora() + ns * 1e-9;
+    while(agora() < fim) ;
+}
+
+//uma das -w threads de aplicação do processo: todas consomem a mesma linha do tempo
+//e avançam o mesmo relógio, cada passo sob snap.m (que também ordena o corte)
 static void *threadRelogio(void *arg){
-    Contexto *ctx=(Contexto*)arg; int pid=ctx->pid;
-
-    Evento eventos_p0[] = {
-        {EVENTO, 'a', -1, 0},
-        {ENVIO,  'b', 1, 'i'},
-        {RECEBIMENTO, 'c', 1, 'h'},
-        {ENVIO,  'd', 2, 'm'},
-        {RECEBIMENTO, 'e', 2, 'l'},
-        {ENVIO,  'f', 1, 'j'},
-        {EVENTO, 'g', -1, 0}
-    };
-    Evento eventos_p1[] = {
-        {ENVIO, 'h', 0, 'c'},
-        {RECEBIMENTO, 'i', 0, 'b'},
-        {RECEBIMENTO, 'j', 0, 'f'}
-    };
-    Evento eventos_p2[] = {
-        {EVENTO, 'k', -1, 0},
-        {ENVIO,  'l', 0, 'e'},
-        {RECEBIMENTO, 'm', 0, 'd'}
-    };
-
-    Evento *lista; int count;
-    if(pid==0){ lista=eventos_p0; count=sizeof(eventos_p0)/sizeof(Evento);} 
-    else if(pid==1){ lista=eventos_p1; count=sizeof(eventos_p1)/sizeof(Evento);} 
-    else { lista=eventos_p2; count=sizeof(eventos_p2)/sizeof(Evento);} 
+    Worker *w=(Worker*)arg; Contexto *ctx=w->ctx; int pid=ctx->pid;
 
-    for(int i=0;i<count;i++){
+    const Evento *lista = ctx->lista; long count = ctx->count;
+    trace_thread(pid, w->id == 0 ? TRACE_RELOGIO : TRACE_SNAPSHOT + w->id, "threadRelogio");
+    int reproduz = ctx->grav.modo == GRAV_REPRODUZ;
+    long passo = 0; //próximo interno ou recebimento na gravação
+
+    for(;;){
+        long i = atomic_fetch_add(&ctx->proximo, 1);
+        if(i >= count) break;
         Evento ev = lista[i];
+        uint64_t t0 = trace_ativo ? trace_ns() : 0;
         if(ev.tipo==EVENTO){
-            ctx->clock.p[pid]++; printClock(pid,&ctx->clock,ev.label,EVENTO,0);
-            // dispara o snapshot após o primeiro envio de P0
-            if(pid==0 && ev.label=='a'){
+            snap_lock_app(ctx);
+            passo = grav_proximo(&ctx->grav, passo, GRAV_BIT(EVENTO) | GRAV_BIT(RECEBIMENTO));
+            vez_espera(ctx, passo++);
+            ctx->clock.p[pid]++;
+            vez_passou(ctx, GRAV_EVENTO);
+            //cópia sob a trava: threadSaida e os outros workers avançam o relógio depois que ela é solta
+            Clock c = ctx->clock;
+            if(trace_ativo) trace_fatia(-1, "evento", t0, trace_ns(), ev.label, 0, c.p, NUM_PROC);
+            pthread_mutex_unlock(&ctx->snap.m);
+            if(!ctx->quiet) Clock_print(pid,&c,ev.label,EVENTO,0);
+            // dispara o snapshot no primeiro evento interno de P0, 'a' no diagrama (se não houver agendador)
+            if(pid==0 && ctx->period_ms <= 0 && ctx->every_k <= 0 && !atomic_exchange(&ctx->disparado, 1))
                 start_snapshot(ctx);
-            }
         } else if(ev.tipo==ENVIO){
             filaEvento_push(&ctx->outbox, ev);
+            if(trace_ativo) trace_fatia(-1, "envio_fila", t0, trace_ns(), ev.label, ev.outroLabel, NULL, 0);
         } else if(ev.tipo==RECEBIMENTO){
-            //espera alguma mensagem e entrega
-            Msg m = filaMsg_pop(&ctx->inbox, &ctx->running);
-            if(!ctx->running) break;
-            //integra relógio
-            clock_max(&ctx->clock, &m.clock);
+            //espera alguma mensagem (ao reproduzir, uma do remetente gravado) e entrega
+            int de = -1;
+            if(reproduz){
+                passo = grav_proximo(&ctx->grav, passo, GRAV_BIT(EVENTO) | GRAV_BIT(RECEBIMENTO));
+                de = ctx->grav.passos[passo];
+            }
+            //retirada e integração atômicas em relação ao corte: a mensagem está no canal ou no relógio;
+            //com vários workers outro pode levar a mensagem entre a espera e a trava, e aí espera de novo
+            Msg *m = NULL;
+            while(!m){
+                if(reproduz ? !filaMsg_wait_de(&ctx->inbox, de, &ctx->running) : !filaMsg_wait(&ctx->inbox, &ctx->running)) break;
+                if(trace_ativo) t0 = trace_ns();
+                snap_lock_app(ctx);
+                m = reproduz ? filaMsg_pop_de(&ctx->inbox, de) : filaMsg_tenta(&ctx->inbox);
+                if(!m) pthread_mutex_unlock(&ctx->snap.m);
+            }
+            if(!m) break;
+            vez_espera(ctx, passo++);
+            Clock_max(&ctx->clock, &m->clock);
             ctx->clock.p[pid]++;
-            printClock(pid,&ctx->clock,ev.label,RECEBIMENTO,ev.outroLabel);
+            vez_passou(ctx, m->from);
+            Clock c = ctx->clock;
+            if(trace_ativo){
+                uint64_t t1 = trace_ns();
+                trace_fluxo('f', trace_id(m->from, m->clock.p[m->from]), t0 + (t1 - t0) / 2);
+                trace_fatia(-1, "recebimento", t0, t1, ev.label, ev.outroLabel, c.p, NUM_PROC);
+            }
+            //devolvida sob a trava: o pool tem um só lado de devolução e os workers se revezam nele
+            pool_devolve(&ctx->pool, m);
+            pthread_mutex_unlock(&ctx->snap.m);
+            MET_CONTA(MC_MERGE);
+            if(!ctx->quiet) Clock_print(pid,&c,ev.label,RECEBIMENTO,ev.outroLabel);
         }
-        usleep(100000);
+        trabalho(ctx->trabalho_ns);
+        sched_tick(ctx);
+        if(ctx->carga.padrao == CARGA_FIXA && !reproduz) usleep(100000);
     }
+    //o último worker a sair encerra a fase da aplicação
+    if(atomic_fetch_sub(&ctx->ativos, 1) == 1) ctx->rel_done = 1;
     pthread_exit(NULL);
 }
 
-int main(){
-    int provided=0; MPI_Init_thread(NULL,NULL,MPI_THREAD_MULTIPLE,&provided);
-    if(provided < MPI_THREAD_MULTIPLE){
-        fprintf(stderr,"MPI não suporta MPI_THREAD_MULTIPLE neste ambiente.\n");
-        MPI_Abort(MPI_COMM_WORLD, 1);
+//coletiva não bloqueante: com -p a espera continua servindo envios e markers dos outros
+static void progress_wait(Contexto *ctx, Pedido *req){
+    int ocioso = 0;
+    for(;;){
+        if(ctx->tr->test(ctx->tr, req)) return;
+        if(ctx->progress && progress_poll(ctx)) ocioso = 0;
+        else progress_idle_wait(ctx, &ocioso);
     }
-    int pid; MPI_Comm_rank(MPI_COMM_WORLD,&pid);
+}
+
+//antes de encerrar: espera que todos concluam a última época iniciada por alguém
+static void snapshot_drain(Contexto *ctx){
+    int epoch, target;
+    Pedido req;
+    pthread_mutex_lock(&ctx->snap.m); epoch = ctx->snap.epoch; pthread_mutex_unlock(&ctx->snap.m);
+    ctx->tr->iallmax(ctx->tr, &epoch, &target, &req);
+    progress_wait(ctx, &req);
+
+    double t0 = agora();
+    int ocioso = 0;
+    for(;;){
+        pthread_mutex_lock(&ctx->snap.m);
+        snapshot_flush(ctx);
+        int pending = snapshot_pendente(ctx) || ctx->snap.epoch < target;
+        pthread_mutex_unlock(&ctx->snap.m);
+        if(!pending && progress_idle(ctx)) break;
+        if(agora() - t0 > 2.0){
+            fprintf(stderr, "P%d: snapshot %d não concluiu antes do encerramento\n", ctx->pid, target);
+            break;
+        }
+        //com -p esta é a thread de progresso
+        if(ctx->progress && progress_poll(ctx)) ocioso = 0;
+        else progress_idle_wait(ctx, &ocioso);
+    }
+    //ninguém para de receber enquanto outro ainda espera canais
+    ctx->tr->ibarrier(ctx->tr, &req);
+    progress_wait(ctx, &req);
+}
 
-    Contexto ctx; ctx.pid=pid; ctx.running=1; memset(&ctx.clock,0,sizeof(Clock));
-    filaMsg_init(&ctx.inbox); filaEvento_init(&ctx.outbox); snapshot_init(&ctx.snap);
+static void snapshot_report(Contexto *ctx){
+    int ctrl = ctx->snap.ctrl_sent, total = 0, done = ctx->snap.completed, done_total = 0;
+    double t_max = 0;
+    Transporte *tr = ctx->tr;
+    tr->reduce(tr, &ctrl, &total, 1, RED_INT, RED_SUM);
+    tr->reduce(tr, &done, &done_total, 1, RED_INT, RED_SUM);
+    tr->reduce(tr, &ctx->snap.t_max, &t_max, 1, RED_DOUBLE, RED_MAX);
+    if(ctx->pid == 0)
+        printf("Resumo (%s): %d mensagens de controle, %d fragmentos concluídos, conclusão máx %.3f ms\n",
+               ctx->modo == SNAP_LY ? "lai-yang" : "chandy-lamport", total, done_total, t_max * 1000.0);
 
-    pthread_t tIn, tOut, tRel;
-    pthread_create(&tIn,NULL,threadEntrada,&ctx);
-    pthread_create(&tOut,NULL,threadSaida,&ctx);
-    pthread_create(&tRel,NULL,threadRelogio,&ctx);
+    long msgs = 0; double lat = 0, dur = 0, t_app = ctx->t_app;
+    tr->reduce(tr, &ctx->app_msgs, &msgs, 1, RED_LONG, RED_SUM);
+    tr->reduce(tr, &ctx->lat_sum, &lat, 1, RED_DOUBLE, RED_SUM);
+    tr->reduce(tr, &t_app, &dur, 1, RED_DOUBLE, RED_MAX);
+    if(ctx->pid == 0 && msgs > 0)
+        printf("Mensagens (%s, %s): %ld em %.3f s, %.1f msg/s, latência média %.1f us\n", tr->nome,
+               ctx->progress ? "progresso único" : "threads",
+               msgs, dur, msgs / dur, lat / msgs * 1e6);
+    //-w/-u: vazão da aplicação (internos, envios e recebimentos de todos os processos)
+    long eventos = ctx->count, eventos_total = 0;
+    tr->reduce(tr, &eventos, &eventos_total, 1, RED_LONG, RED_SUM);
+    if(ctx->pid == 0 && (ctx->workers > 1 || ctx->trabalho_ns > 0) && dur > 0)
+        printf("Aplicação (%d workers por processo, %ld ns por evento): %ld eventos em %.3f s, %.0f eventos/s\n",
+               ctx->workers, ctx->trabalho_ns, eventos_total, dur, eventos_total / dur);
 
-    pthread_join(tRel,NULL);
-    ctx.running=0; 
-    pthread_cond_broadcast(&ctx.inbox.c); pthread_cond_broadcast(&ctx.outbox.c);
-    pthread_join(tIn,NULL); pthread_join(tOut,NULL);
+    //custo por snapshot: tempos pelo pior processo, volumes somados
+    int n = ctx->snap.epoch + 1 < MAX_SNAPS ? ctx->snap.epoch + 1 : MAX_SNAPS;
+    double tl[3*MAX_SNAPS], tg[3*MAX_SNAPS];
+    int cl[3*MAX_SNAPS], cg[3*MAX_SNAPS];
+    for(int e=0;e<n;e++){
+        tl[3*e] = ctx->snap.custo[e].captura; tl[3*e+1] = ctx->snap.custo[e].fechamento; tl[3*e+2] = ctx->snap.custo[e].atraso;
+        cl[3*e] = ctx->snap.custo[e].msgs; cl[3*e+1] = ctx->snap.custo[e].atrasados; cl[3*e+2] = ctx->snap.custo[e].bytes;
+    }
+    tr->reduce(tr, tl, tg, 3*n, RED_DOUBLE, RED_MAX);
+    tr->reduce(tr, cl, cg, 3*n, RED_INT, RED_SUM);
+    if(ctx->pid == 0 && n > 1){
+        if(ctx->period_ms > 0 || ctx->every_k > 0)
+            printf("Agendador: %d snapshots disparados, %d descartados (anterior em andamento)\n", ctx->scheduled, ctx->skipped);
+        printf("snap,captura_us,fechamento_ms,msgs_canal,bytes_controle,eventos_atrasados,atraso_max_us\n");
+        for(int e=1;e<n;e++)
+            printf("%d,%.1f,%.3f,%d,%d,%d,%.1f\n", e, tg[3*e]*1e6, tg[3*e+1]*1e3, cg[3*e],
+                   cg[3*e+2], cg[3*e+1], tg[3*e+2]*1e6);
+    }
+}
+
+static void usage(const char *prog){
+    fprintf(stderr, "uso: %s [-m cl|ly] [-f ms] [-g] [-T ms] [-K n] [-j ms] [-n max] [-p] [-t mpi|shm]\n"
+                    "       [-W " CARGA_NOMES "] [-e n] [-i frac] [-b n] [-s seed] [-q] [-x trace.json]\n"
+                    "       [-r gravacao | -y gravacao] [-w workers] [-u ns]\n", prog);
+}
+
+//ciclo de vida de um processo lógico: threads, fase da aplicação, encerramento e resumo
+static void rank_run(Contexto *ctx){
+    filaMsg_init(&ctx->inbox); filaEvento_init(&ctx->outbox); snapshot_init(&ctx->snap);
+    if(!pool_init(&ctx->pool, MAX_POOL, sizeof(Msg))){ perror("pool de mensagens"); exit(1); }
+    ctx->rx = NULL;
+    pthread_mutex_init(&ctx->sched_m,NULL); pthread_cond_init(&ctx->sched_c,NULL);
+    pthread_cond_init(&ctx->vez,NULL);
+    filaEnvio_init(&ctx->saida);
+    for(int i=0;i<MAX_INFLIGHT;i++){ ctx->inflight_req[i] = MPI_REQUEST_NULL; ctx->inflight[i].heap = NULL; }
+    int agenda = ctx->pid == 0 && (ctx->period_ms > 0 || ctx->every_k > 0);
+
+    int count;
+    ctx->lista = carga_gerar(&ctx->carga, ctx->pid, &count);
+    ctx->count = count;
+    memset(ctx->origem, 0, sizeof(ctx->origem)); memset(ctx->destino, 0, sizeof(ctx->destino));
+    for(int i=0;i<count;i++){
+        if(ctx->lista[i].tipo == ENVIO) ctx->destino[ctx->lista[i].destino_ou_origem] = 1;
+        else if(ctx->lista[i].tipo == RECEBIMENTO) ctx->origem[ctx->lista[i].destino_ou_origem] = 1;
+    }
+    atomic_init(&ctx->proximo, 0); atomic_init(&ctx->ativos, ctx->workers); atomic_init(&ctx->disparado, 0);
+    Worker ws[MAX_WORKERS];
+
+    double t0 = agora();
+    pthread_t tIn, tOut, tRel[MAX_WORKERS], tAg;
+    if(!ctx->progress) pthread_create(&tIn,NULL,threadEntrada,ctx);
+    pthread_create(&tOut,NULL,threadSaida,ctx);
+    for(int w=0;w<ctx->workers;w++){
+        ws[w] = (Worker){ctx, w};
+        pthread_create(&tRel[w],NULL,threadRelogio,&ws[w]);
+    }
+    if(agenda) pthread_create(&tAg,NULL,threadAgenda,ctx);
+
+    //com -p a thread que chamou rank_run é o motor de progresso enquanto a aplicação roda
+    if(ctx->progress) trace_thread(ctx->pid, TRACE_ENTRADA, "progresso");
+    int ocioso = 0;
+    if(ctx->progress)
+        while(!ctx->rel_done){
+            if(progress_poll(ctx)) ocioso = 0;
+            else progress_idle_wait(ctx, &ocioso);
+        }
+
+    for(int w=0;w<ctx->workers;w++) pthread_join(tRel[w],NULL);
+    ctx->t_app = agora() - t0;
+    pthread_mutex_lock(&ctx->sched_m); ctx->app_done=1; pthread_cond_signal(&ctx->sched_c); pthread_mutex_unlock(&ctx->sched_m);
+    if(agenda) pthread_join(tAg,NULL);
+    snapshot_drain(ctx);
+    ctx->running=0; 
+    pthread_cond_broadcast(&ctx->inbox.c); pthread_cond_broadcast(&ctx->outbox.c);
+    if(!ctx->progress) pthread_join(tIn,NULL);
+    pthread_join(tOut,NULL);
+
+    snapshot_report(ctx);
+    if(ctx->grav.modo == GRAV_GRAVA) grav_salva(&ctx->grav, ctx->pid, &ctx->carga);
+    grav_libera(&ctx->grav);
+    pool_libera(&ctx->pool);
+    free(ctx->lista);
+}
+
+static void *threadProcesso(void *arg){
+    rank_run((Contexto*)arg);
+    return NULL;
+}
+
+int main(int argc, char **argv){
+    Contexto ctx; ctx.running=1; memset(&ctx.clock,0,sizeof(Clock));
+    ctx.modo=SNAP_CL; ctx.flush_ms=100; ctx.gather=0;
+    ctx.period_ms=0; ctx.jitter_ms=0; ctx.every_k=0; ctx.max_snaps=MAX_SNAPS-1;
+    ctx.app_events=0; ctx.scheduled=0; ctx.skipped=0; ctx.app_done=0;
+    ctx.progress=0; ctx.rel_done=0; ctx.inflight_n=0; ctx.app_msgs=0; ctx.lat_sum=0; ctx.t_app=0;
+    int shm=0;
+    carga_init(&ctx.carga, NUM_PROC); ctx.quiet=0;
+    grav_init(&ctx.grav, GRAV_NADA, NULL);
+    ctx.workers=1; ctx.trabalho_ns=0;
+
+    //opções antes de MPI_Init: o nível de threads pedido depende de -p
+    int opt, bad=0;
+    while((opt = getopt(argc, argv, "m:f:gT:K:j:n:pt:W:e:i:b:s:qx:r:y:w:u:")) != -1){
+        switch(opt){
+            case 'm':
+                if(!strcmp(optarg, "cl")) ctx.modo = SNAP_CL;
+                else if(!strcmp(optarg, "ly")) ctx.modo = SNAP_LY;
+                else bad = 1;
+                break;
+            case 'f': ctx.flush_ms = atoi(optarg); break;
+            case 'g': ctx.gather = 1; break;
+            case 'T': ctx.period_ms = atoi(optarg); break;
+            case 'K': ctx.every_k = atoi(optarg); break;
+            case 'j': ctx.jitter_ms = atoi(optarg); break;
+            case 'n': ctx.max_snaps = atoi(optarg) < MAX_SNAPS-1 ? atoi(optarg) : MAX_SNAPS-1; break;
+            case 'p': ctx.progress = 1; break;
+            case 't':
+                if(!strcmp(optarg, "mpi")) shm = 0;
+                else if(!strcmp(optarg, "shm")) shm = 1;
+                else bad = 1;
+                break;
+            case 'W': if(!carga_padrao(&ctx.carga, optarg)) bad = 1; break;
+            case 'e': ctx.carga.eventos = atol(optarg); break;
+            case 'i': ctx.carga.interno = atof(optarg); break;
+            case 'b': ctx.carga.rajada = atoi(optarg); break;
+            case 's': ctx.carga.seed = (unsigned)atol(optarg); break;
+            case 'q': ctx.quiet = 1; break;
+            case 'x':
+                if(!trace_init(optarg)){ perror(optarg); bad = 1; }
+                break;
+            case 'r': grav_init(&ctx.grav, GRAV_GRAVA, optarg); break;
+            case 'y': grav_init(&ctx.grav, GRAV_REPRODUZ, optarg); break;
+            case 'w': ctx.workers = atoi(optarg); if(ctx.workers < 1 || ctx.workers > MAX_WORKERS) bad = 1; break;
+            case 'u': ctx.trabalho_ns = atol(optarg); break;
+            default: bad = 1;
+        }
+    }
+    //a gravação segue a ordem da linha do tempo, que vários workers não preservam
+    if(ctx.workers > 1 && ctx.grav.modo != GRAV_NADA){
+        fprintf(stderr, "-r e -y exigem -w 1\n");
+        bad = 1;
+    }
+    //a carga vale para NUM_PROC processos; confere antes de criar qualquer thread
+    int nteste; Evento *teste = carga_gerar(&ctx.carga, 0, &nteste);
+    if(!teste){
+        fprintf(stderr, "carga inválida para NUM_PROC=%d (fixo exige 3 processos)\n", NUM_PROC);
+        bad = 1;
+    }
+    free(teste);
+
+    if(shm){
+        //um processo do SO, NUM_PROC processos lógicos; MPI não é inicializado
+        if(bad){ usage(argv[0]); return 1; }
+        ShmMundo *w = calloc(1, sizeof(ShmMundo));
+        ShmRank *r = calloc(NUM_PROC, sizeof(ShmRank));
+        Transporte *tr = calloc(NUM_PROC, sizeof(Transporte));
+        Contexto *ctxs = malloc(NUM_PROC * sizeof(Contexto));
+        pthread_t th[NUM_PROC];
+        for(int i=0;i<NUM_PROC;i++){
+            r[i].w = w;
+            transporte_shm(&tr[i], &r[i], i);
+            ctxs[i] = ctx; ctxs[i].pid = i; ctxs[i].tr = &tr[i];
+            if(ctx.grav.modo == GRAV_REPRODUZ && !grav_carrega(&ctxs[i].grav, i, &ctx.carga)) return 1;
+        }
+        MET_INIT("rvet_snapshot shm");
+        for(int i=0;i<NUM_PROC;i++) pthread_create(&th[i], NULL, threadProcesso, &ctxs[i]);
+        for(int i=0;i<NUM_PROC;i++) pthread_join(th[i], NULL);
+        MET_FIM();
+        trace_fim(0); trace_junta(1, NUM_PROC);
+        free(ctxs); free(tr); free(r); free(w);
+        return 0;
+    }
+
+    int required = ctx.progress ? MPI_THREAD_FUNNELED : MPI_THREAD_MULTIPLE;
+    int provided=0; MPI_Init_thread(&argc,&argv,required,&provided);
+    int pid, size; MPI_Comm_rank(MPI_COMM_WORLD,&pid); MPI_Comm_size(MPI_COMM_WORLD,&size);
+    if(bad){ if(pid==0) usage(argv[0]); MPI_Finalize(); return 1; }
+    if(size != NUM_PROC){
+        if(pid==0) fprintf(stderr,"compilado para %d processos, executado com %d (make NP=%d)\n", NUM_PROC, size, size);
+        MPI_Finalize(); return 1;
+    }
+    if(provided < required){
+        fprintf(stderr,"MPI não suporta %s neste ambiente.\n", ctx.progress ? "MPI_THREAD_FUNNELED" : "MPI_THREAD_MULTIPLE");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    Transporte tr; transporte_mpi(&tr);
+    ctx.pid=pid; ctx.tr=&tr;
+    if(ctx.grav.modo == GRAV_REPRODUZ && !grav_carrega(&ctx.grav, pid, &ctx.carga)) MPI_Abort(MPI_COMM_WORLD, 1);
+
+    MET_INIT("rvet_snapshot");
+    rank_run(&ctx);
+    MET_FIM();
+    //cada rank grava a sua parte; P0 junta depois que todos terminaram
+    if(trace_ativo){
+        trace_fim(pid);
+        MPI_Barrier(MPI_COMM_WORLD);
+        if(pid == 0) trace_junta(size, NUM_PROC);
+    }
 
     MPI_Finalize();
     return 0;
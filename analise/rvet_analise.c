@@ -0,0 +1,461 @@
+/**
+ * Analisador offline dos logs de relógios vetoriais das etapas
+ *
+ * Compilação: make (liga ../comum/libcomum.a)
+ * Execução: ./rvet_analise [-t threads] [-l n] [-C limite] [-c c0,c1,...] log
+ *
+ *   log    saída de rvet.1, rvet_pth ou rvet_snapshot (sem -q): as linhas
+ *          "P0|a (1, 0, 0) evento interno" / "envio para x" / "recebido de x"
+ *          são os eventos, as demais são ignoradas
+ *   -t n   threads (padrão: processadores disponíveis)
+ *   -l n   lista até n pares concorrentes, eventos do caminho crítico e cortes (padrão 20)
+ *   -C n   para de contar cortes consistentes depois de n (padrão 10000000)
+ *   -c ... verifica o corte com c_i eventos do processo i
+ *
+ * O log é mapeado com mmap e dividido em faixas de linhas, uma por thread; cada
+ * evento vai direto para a posição dada pela própria entrada do relógio (o k-ésimo
+ * evento de Pi tem V[i] = k), sem ordenação. A relação happens-before sai dos
+ * próprios relógios: e -> f  sse  V(e) <= V(f) e V(e) != V(f).
+ *
+ *   pares concorrentes  C(E,2) menos os pares ordenados; o passado causal de f tem
+ *                       soma(V(f)) - 1 eventos, então a contagem é O(E N)
+ *   caminho crítico     maior cadeia happens-before; o último evento de Pj antes
+ *                       de f é o V(f)[j]-ésimo, então prof(f) = 1 + máx sobre j
+ *                       de prof(evento V(f)[j] de Pj), em ordem de soma(V)
+ *   cortes              (c_0..c_N-1) é consistente sse o último evento incluído de
+ *                       cada Pi não conhece mais de c_j eventos de Pj; a contagem
+ *                       percorre o reticulado com poda (iterativa, mínimos no heap),
+ *                       em paralelo sobre c_0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "vclock.h"
+
+typedef struct {
+    int rank, idx;     //idx = V[rank], 1..n_rank
+    char label, tipo, outro;
+} Reg;
+
+//faixa do log analisada por uma thread
+typedef struct {
+    const char *ini, *fim;
+    Reg *regs; int *clocks; long n, cap;
+    long linha_ruim;
+} Faixa;
+
+//eventos em ordem (processo, índice): posição base[r] + idx - 1
+static int N;
+static long E;
+static long *base, *qtd;
+static int *V;
+static char *label, *tipo, *outro;
+static atomic_char *visto;  //posição já ocupada ao espalhar (repetidos podem vir de threads diferentes)
+static int *prof, *pred;
+
+static int nthreads;
+
+static double agora(void){
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* --------------------------------- Leitura --------------------------------- */
+
+static int le_int(const char **p, const char *fim, int *v){
+    const char *s = *p; int x = 0;
+    if(s >= fim || *s < '0' || *s > '9') return 0;
+    while(s < fim && *s >= '0' && *s <= '9') x = x*10 + (*s++ - '0');
+    *v = x; *p = s; return 1;
+}
+
+static int prefixo(const char *s, const char *fim, const char *pre){
+    size_t n = strlen(pre);
+    return (size_t)(fim - s) >= n && !memcmp(s, pre, n);
+}
+
+//"P<pid>|<label> (<c0>, <c1>, ...) <tipo>": 1 se evento, 0 se outra linha, -1 se evento mal formado.
+//Com c == NULL só conta as entradas do relógio (em *n)
+static int le_linha(const char *s, const char *fim, Reg *r, int *c, int *n){
+    int v, k = 0;
+    if(s >= fim || *s != 'P') return 0;
+    s++;
+    if(!le_int(&s, fim, &r->rank) || s + 4 > fim || *s != '|') return 0;
+    r->label = s[1];
+    if(s[2] != ' ' || s[3] != '(') return 0;
+    s += 4;
+    for(;;){
+        if(!le_int(&s, fim, &v)) return -1;
+        if(c){ if(k == N) return -1; c[k] = v; }
+        k++;
+        if(s < fim && *s == ')'){ s++; break; }
+        if(s + 2 > fim || s[0] != ',' || s[1] != ' ') return -1;
+        s += 2;
+    }
+    *n = k;
+    if(!c) return 1;
+    if(k != N || r->rank < 0 || r->rank >= N) return -1;
+    r->idx = c[r->rank];
+    r->outro = 0;
+    if(prefixo(s, fim, " evento interno")) r->tipo = VC_EVENTO;
+    else if(prefixo(s, fim, " envio")){ r->tipo = VC_ENVIO; if(prefixo(s, fim, " envio para x")) r->outro = s[12]; }
+    else if(prefixo(s, fim, " recebido")){ r->tipo = VC_RECEBIMENTO; if(prefixo(s, fim, " recebido de x")) r->outro = s[13]; }
+    else return -1;
+    return 1;
+}
+
+static int le_evento(Faixa *f, const char *s, const char *fim){
+    if(f->n == f->cap){
+        f->cap = f->cap ? 2*f->cap : 4096;
+        f->regs = realloc(f->regs, f->cap * sizeof(Reg));
+        f->clocks = realloc(f->clocks, f->cap * (size_t)N * sizeof(int));
+    }
+    int n, r = le_linha(s, fim, &f->regs[f->n], f->clocks + f->n * N, &n);
+    if(r > 0) f->n++;
+    return r;
+}
+
+static void *threadLeitura(void *arg){
+    Faixa *f = (Faixa*)arg;
+    const char *s = f->ini;
+    while(s < f->fim){
+        const char *nl = memchr(s, '\n', f->fim - s);
+        const char *fim = nl ? nl : f->fim;
+        if(le_evento(f, s, fim) < 0) f->linha_ruim++;
+        s = fim + 1;
+    }
+    return NULL;
+}
+
+//cada registro vai para a posição do seu índice; repetidos e fora do intervalo são erros
+static void *threadEspalha(void *arg){
+    Faixa *f = (Faixa*)arg;
+    for(long k=0;k<f->n;k++){
+        Reg *r = &f->regs[k];
+        if(r->idx < 1 || r->idx > qtd[r->rank]){ f->linha_ruim++; continue; }
+        long e = base[r->rank] + r->idx - 1;
+        if(atomic_exchange_explicit(&visto[e], 1, memory_order_relaxed)){ f->linha_ruim++; continue; }
+        label[e] = r->label; tipo[e] = r->tipo; outro[e] = r->outro;
+        memcpy(V + e*N, f->clocks + k*N, N * sizeof(int));
+    }
+    return NULL;
+}
+
+/* --------------------------------- Análise --------------------------------- */
+
+typedef struct { long ini, fim, comparaveis, ruins; } Parte;
+
+//soma dos passados causais e conferência das entradas de cada relógio
+static void *threadPassado(void *arg){
+    Parte *p = (Parte*)arg;
+    for(long e=p->ini;e<p->fim;e++){
+        const int *v = V + e*N;
+        long s = 0;
+        for(int j=0;j<N;j++){
+            if(v[j] < 0 || v[j] > qtd[j]) p->ruins++;
+            s += v[j];
+        }
+        p->comparaveis += s - 1;
+    }
+    return NULL;
+}
+
+static void paralelo(void *(*fn)(void*), Parte *partes, long n){
+    pthread_t th[nthreads];
+    for(int t=0;t<nthreads;t++){
+        partes[t].ini = n * t / nthreads; partes[t].fim = n * (t+1) / nthreads;
+        partes[t].comparaveis = partes[t].ruins = 0;
+        pthread_create(&th[t], NULL, fn, &partes[t]);
+    }
+    for(int t=0;t<nthreads;t++) pthread_join(th[t], NULL);
+}
+
+static int rank_de(long e){
+    int r = 0;
+    while(r+1 < N && base[r+1] <= e) r++;
+    return r;
+}
+
+//maior cadeia happens-before terminando em cada evento, em ordem de soma(V)
+static void profundidades(void){
+    long *cont = calloc(E + 2, sizeof(long)), *ordem = malloc(E * sizeof(long));
+    int *soma = malloc(E * sizeof(int));
+    for(long e=0;e<E;e++){
+        long s = 0; for(int j=0;j<N;j++) s += V[e*N+j];
+        soma[e] = (int)(s <= E ? s : E + 1);
+        cont[soma[e]]++;
+    }
+    for(long s=1;s<=E+1;s++) cont[s] += cont[s-1];
+    for(long e=E-1;e>=0;e--) ordem[--cont[soma[e]]] = e;
+
+    for(long k=0;k<E;k++){
+        long e = ordem[k];
+        int r = rank_de(e), melhor = 0; long p = -1;
+        const int *v = V + e*N;
+        for(int j=0;j<N;j++){
+            int i = j == r ? v[j] - 1 : v[j];  //no próprio processo, o evento anterior
+            if(i <= 0) continue;
+            long q = base[j] + i - 1;
+            if(prof[q] > melhor){ melhor = prof[q]; p = q; }
+        }
+        prof[e] = melhor + 1; pred[e] = (int)p;
+    }
+    free(cont); free(ordem); free(soma);
+}
+
+/* ---------------------------------- Cortes --------------------------------- */
+
+static long limite_cortes;
+static atomic_long cortes;
+static atomic_int proximo_c0;
+
+//requisito do k-ésimo evento de Pi sobre Pj (0 se k = 0)
+static inline int req(int i, int k, int j){ return k ? V[(base[i] + k - 1)*N + j] : 0; }
+
+//linha i da matriz triangular de mínimos: só as colunas j >= i, N(N+1)/2 inteiros ao todo
+static inline int *linha(int *minimo, int i){ return minimo + (long)i*N - (long)i*(i-1)/2 - i; }
+
+//conta (ou lista, se lista > 0) os cortes que estendem c[0..i0-1]. Sem recursão: a linha i
+//de minimo (no heap) tem os eventos de cada Pj exigidos no nível i, e a linha i0 já vem preenchida
+static void percorre(int i0, int *c, int *minimo, int *lista){
+    int i = i0;
+    c[i] = linha(minimo, i)[i] - 1;
+    while(i >= i0){
+        if(atomic_load_explicit(&cortes, memory_order_relaxed) > limite_cortes) return;
+        if(i == N){
+            long n = atomic_fetch_add(&cortes, 1);
+            if(lista && n < *lista){
+                printf("  ("); for(int j=0;j<N;j++) printf(j ? ",%d" : "%d", c[j]); printf(")\n");
+            }
+            i--;
+            continue;
+        }
+        int k = ++c[i], ok = k <= qtd[i];
+        //o k-ésimo evento de Pi não pode conhecer mais eventos dos processos já fixados
+        for(int j=0;ok && j<i;j++) if(req(i, k, j) > c[j]) ok = 0;
+        if(!ok){ i--; continue; }  //requisitos só crescem com k
+        const int *m = linha(minimo, i);
+        int *prox = linha(minimo, i+1);
+        for(int j=i+1;j<N;j++) prox[j] = req(i, k, j) > m[j] ? req(i, k, j) : m[j];
+        if(++i < N) c[i] = prox[i] - 1;
+    }
+}
+
+static void *threadCortes(void *arg){
+    (void)arg;
+    int *c = malloc(N * sizeof(int)), *m = malloc((size_t)N * (N+1) / 2 * sizeof(int)), *m1 = linha(m, 1);
+    for(;;){
+        int c0 = atomic_fetch_add(&proximo_c0, 1);
+        if(c0 > qtd[0] || atomic_load(&cortes) > limite_cortes) break;
+        c[0] = c0;
+        for(int j=1;j<N;j++) m1[j] = req(0, c0, j);
+        percorre(1, c, m, NULL);
+    }
+    free(c); free(m);
+    return NULL;
+}
+
+//"c0,c1,...": quantos inteiros há (os N primeiros vão para c); -1 se algum valor não é inteiro
+static int le_corte(const char *s, int *c){
+    int n = 0;
+    for(const char *p=s;; p++){
+        char *q;
+        long v = strtol(p, &q, 10);
+        if(q == p || (*q && *q != ',')) return -1;
+        if(n < N) c[n] = (int)v;
+        n++;
+        p = q;
+        if(!*p) return n;
+    }
+}
+
+//0 se consistente; senão preenche o par (i, j) violado
+static int verifica_corte(const int *c, int *vi, int *vj){
+    for(int i=0;i<N;i++){
+        if(c[i] < 0 || c[i] > qtd[i]){ *vi = *vj = i; return 1; }
+        for(int j=0;j<N;j++)
+            if(j != i && req(i, c[i], j) > c[j]){ *vi = i; *vj = j; return 1; }
+    }
+    return 0;
+}
+
+/* ----------------------------------- main ---------------------------------- */
+
+static void usage(const char *prog){
+    fprintf(stderr, "uso: %s [-t threads] [-l n] [-C limite] [-c c0,c1,...] log\n", prog);
+}
+
+int main(int argc, char **argv){
+    nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int lista = 20; limite_cortes = 10000000;
+    const char *corte = NULL;
+    int opt;
+    while((opt = getopt(argc, argv, "t:l:C:c:")) != -1){
+        switch(opt){
+            case 't': nthreads = atoi(optarg); break;
+            case 'l': lista = atoi(optarg); break;
+            case 'C': limite_cortes = atol(optarg); break;
+            case 'c': corte = optarg; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if(optind != argc - 1 || nthreads < 1){ usage(argv[0]); return 1; }
+
+    double t0 = agora();
+    int fd = open(argv[optind], O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) < 0){ perror(argv[optind]); return 1; }
+    if(st.st_size == 0){ fprintf(stderr, "%s: vazio\n", argv[optind]); return 1; }
+    const char *mapa = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(mapa == MAP_FAILED){ perror("mmap"); return 1; }
+    madvise((void*)mapa, st.st_size, MADV_SEQUENTIAL);
+    const char *fim = mapa + st.st_size;
+
+    //N vem da primeira linha de evento
+    for(const char *p=mapa; p<fim && !N; ){
+        const char *nl = memchr(p, '\n', fim - p), *f = nl ? nl : fim;
+        Reg r; int n;
+        if(le_linha(p, f, &r, NULL, &n) > 0) N = n;
+        p = f + 1;
+    }
+    if(!N){ fprintf(stderr, "nenhum evento em %s (rodou com -q?)\n", argv[optind]); return 1; }
+    //-c confere com o número de processos antes da análise
+    int cc[N];
+    if(corte){
+        int n = le_corte(corte, cc);
+        if(n < 0){ fprintf(stderr, "-c %s: valores devem ser inteiros separados por vírgula\n", corte); return 1; }
+        if(n != N){ fprintf(stderr, "-c: %d valores, o log tem %d processos\n", n, N); return 1; }
+    }
+
+    //faixas terminadas em fim de linha
+    Faixa *fx = calloc(nthreads, sizeof(Faixa));
+    pthread_t th[nthreads];
+    const char *s = mapa;
+    for(int t=0;t<nthreads;t++){
+        const char *f = t == nthreads-1 ? fim : mapa + st.st_size * (t+1) / nthreads;
+        if(f < s) f = s;
+        while(f < fim && f[-1] != '\n') f++;
+        fx[t].ini = s; fx[t].fim = f; s = f;
+        pthread_create(&th[t], NULL, threadLeitura, &fx[t]);
+    }
+    for(int t=0;t<nthreads;t++) pthread_join(th[t], NULL);
+
+    long ruins = 0, lidos = 0;
+    for(int t=0;t<nthreads;t++){ lidos += fx[t].n; ruins += fx[t].linha_ruim; }
+
+    //eventos por processo = maior índice visto (num log completo, todos de 1 a n)
+    base = calloc(N + 1, sizeof(long)); qtd = calloc(N, sizeof(long));
+    for(int t=0;t<nthreads;t++)
+        for(long k=0;k<fx[t].n;k++) if(fx[t].regs[k].idx > qtd[fx[t].regs[k].rank]) qtd[fx[t].regs[k].rank] = fx[t].regs[k].idx;
+    for(int i=0;i<N;i++) base[i+1] = base[i] + qtd[i];
+    E = base[N];
+    V = malloc(E * N * sizeof(int));
+    label = calloc(E, 1); tipo = calloc(E, 1); outro = calloc(E, 1); visto = calloc(E, sizeof(atomic_char));
+    for(int t=0;t<nthreads;t++){ fx[t].linha_ruim = 0; pthread_create(&th[t], NULL, threadEspalha, &fx[t]); }
+    for(int t=0;t<nthreads;t++) pthread_join(th[t], NULL);
+    free(visto);
+    long repetidos = 0;
+    for(int t=0;t<nthreads;t++){ repetidos += fx[t].linha_ruim; free(fx[t].regs); free(fx[t].clocks); }
+    double t_leitura = agora() - t0;
+
+    if(ruins) fprintf(stderr, "aviso: %ld linhas de evento mal formadas ignoradas\n", ruins);
+    if(repetidos || lidos - repetidos != E){
+        fprintf(stderr, "log incompleto: %ld eventos lidos, %ld repetidos, %ld esperados pelos índices\n",
+                lidos, repetidos, E);
+        for(long e=0, k=0; e<E && k<lista; e++)
+            if(!label[e]){ fprintf(stderr, "  falta o evento %ld de P%d\n", e - base[rank_de(e)] + 1, rank_de(e)); k++; }
+        return 1;
+    }
+
+    double t1 = agora();
+    Parte partes[nthreads];
+    paralelo(threadPassado, partes, E);
+    long comparaveis = 0, fora = 0;
+    for(int t=0;t<nthreads;t++){ comparaveis += partes[t].comparaveis; fora += partes[t].ruins; }
+    if(fora){ fprintf(stderr, "log inconsistente: %ld entradas de relógio além dos eventos do processo\n", fora); return 1; }
+
+    prof = malloc(E * sizeof(int)); pred = malloc(E * sizeof(int));
+    profundidades();
+    double t_analise = agora() - t1;
+
+    long envios = 0, recebimentos = 0;
+    for(long e=0;e<E;e++){ envios += tipo[e] == VC_ENVIO; recebimentos += tipo[e] == VC_RECEBIMENTO; }
+    long pares = E * (E - 1) / 2;
+    printf("Eventos: %ld em %d processos (%ld envios, %ld recebimentos, %ld internos)\n",
+           E, N, envios, recebimentos, E - envios - recebimentos);
+    printf("Pares ordenados (happens-before): %ld, concorrentes: %ld de %ld\n", comparaveis, pares - comparaveis, pares);
+
+    //lista pares concorrentes só para logs pequenos (O(E^2))
+    if(lista > 0 && E <= 4096){
+        int k = 0;
+        for(long a=0;a<E && k<lista;a++)
+            for(long b=a+1;b<E && k<lista;b++)
+                if(vclock_compara(V + a*N, V + b*N, N) == VC_CONCORRENTE){
+                    printf("  %c || %c\n", label[a], label[b]); k++;
+                }
+    }
+
+    long ult = 0;
+    for(long e=1;e<E;e++) if(prof[e] > prof[ult]) ult = e;
+    printf("Caminho crítico: %d eventos\n", prof[ult]);
+    if(lista > 0 && prof[ult] <= lista){
+        long *cam = malloc(prof[ult] * sizeof(long)); int n = 0;
+        for(long e=ult; e>=0; e=pred[e]) cam[n++] = e;
+        printf(" ");
+        for(int k=n-1;k>=0;k--){ printf(" P%d|%c", rank_de(cam[k]), label[cam[k]]); if(k) printf(" ->"); }
+        printf("\n");
+        free(cam);
+    }
+
+    printf("processo,eventos,envios,recebimentos,profundidade_causal,passado_causal\n");
+    for(int i=0;i<N;i++){
+        long env = 0, rec = 0, maxp = 0;
+        for(long e=base[i];e<base[i+1];e++){
+            env += tipo[e] == VC_ENVIO; rec += tipo[e] == VC_RECEBIMENTO;
+            if(prof[e] > maxp) maxp = prof[e];
+        }
+        long passado = 0;
+        if(qtd[i]) for(int j=0;j<N;j++) passado += V[(base[i+1]-1)*N + j];
+        printf("P%d,%ld,%ld,%ld,%ld,%ld\n", i, qtd[i], env, rec, maxp, passado ? passado - 1 : 0);
+    }
+
+    double t2 = agora();
+    pthread_t tc[nthreads];
+    for(int t=0;t<nthreads;t++) pthread_create(&tc[t], NULL, threadCortes, NULL);
+    for(int t=0;t<nthreads;t++) pthread_join(tc[t], NULL);
+    long nc = atomic_load(&cortes);
+    double t_cortes = agora() - t2;
+    if(nc > limite_cortes) printf("Cortes consistentes: mais de %ld (-C para contar além)\n", limite_cortes);
+    else {
+        printf("Cortes consistentes: %ld\n", nc);
+        if(lista > 0 && nc <= lista){
+            int *c = malloc(N * sizeof(int)), *m = calloc((size_t)N * (N+1) / 2, sizeof(int));
+            atomic_store(&cortes, 0);
+            percorre(0, c, m, &lista);
+            free(c); free(m);
+        }
+    }
+
+    if(corte){
+        const int *c = cc;
+        int vi, vj;
+        if(!verifica_corte(c, &vi, &vj)) printf("Corte -c: consistente\n");
+        else if(vi == vj) printf("Corte -c: P%d tem %ld eventos\n", vi, qtd[vi]);
+        else printf("Corte -c: inconsistente, o evento %d de P%d conhece %d eventos de P%d (corte tem %d)\n",
+                    c[vi], vi, req(vi, c[vi], vj), vj, c[vj]);
+    }
+
+    fprintf(stderr, "Tempo: leitura %.3f s, análise %.3f s, cortes %.3f s; %.2f M eventos/s (%d threads)\n",
+            t_leitura, t_analise, t_cortes, E / (t_leitura + t_analise) / 1e6, nthreads);
+    munmap((void*)mapa, st.st_size); close(fd);
+    return 0;
+}
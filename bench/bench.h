@@ -0,0 +1,19 @@
+/**
+ * Interface entre o rvet_bench e as unidades que embutem as filas das etapas 2 e 3
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <time.h>
+
+//segundos para n itens; threads 1 = push e pop alternados, 2 = produtor e consumidor
+double bench_e2_fila(long n, int threads);
+double bench_e3_fila(long n, int threads);
+
+static inline double bench_agora(void){
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#endif
@@ -0,0 +1,40 @@
+/**
+ * Fila de tarefas da Etapa 2 (submitTask/getTask) compilada como está, para o rvet_bench
+ * Os printf de buffer cheio/vazio são suprimidos: mede-se a fila, não o terminal.
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#define printf(...) ((void)0)
+#define main pth_pool_main
+#include "../E2 - Modelo Produtor Consumidor/pth_pool.c"
+#undef main
+#undef printf
+#include "bench.h"
+
+static void *consumidor(void *arg){
+    long n = *(long*)arg;
+    for(long i=0;i<n;i++){ Clock t = getTask(); __asm__ volatile("" : : "g"(&t) : "memory"); }
+    return NULL;
+}
+
+double bench_e2_fila(long n, int threads){
+    static int iniciada;
+    if(!iniciada){
+        pthread_mutex_init(&mutex, NULL);
+        pthread_cond_init(&condEmpty, NULL);
+        pthread_cond_init(&condFull, NULL);
+        iniciada = 1;
+    }
+    Clock c = {{0}};
+    double t0 = bench_agora();
+    if(threads == 1){
+        for(long i=0;i<n;i++){ c.p[0] = i; submitTask(c); c = getTask(); }
+    } else {
+        pthread_t th;
+        pthread_create(&th, NULL, consumidor, &n);
+        for(long i=0;i<n;i++){ c.p[0] = i; submitTask(c); }
+        pthread_join(th, NULL);
+    }
+    return bench_agora() - t0;
+}
@@ -0,0 +1,32 @@
+/**
+ * Fila de eventos da Etapa 3 (pushFila/popFila) compilada como está, para o rvet_bench
+ */
+
+#define main rvet_pth_main
+#include "../E3 - Integração Produtor Consumidor Relógios Vetoriais/rvet_pth.c"
+#undef main
+#include "bench.h"
+
+static Fila fila;
+static volatile int running = 1;
+
+static void *consumidor(void *arg){
+    long n = *(long*)arg;
+    for(long i=0;i<n;i++){ Evento ev = popFila(&fila, &running, NULL); __asm__ volatile("" : : "g"(&ev) : "memory"); }
+    return NULL;
+}
+
+double bench_e3_fila(long n, int threads){
+    Evento ev = {ENVIO, 'b', 1, 'i'};
+    initFila(&fila, MF_SAIDA);
+    double t0 = bench_agora();
+    if(threads == 1){
+        for(long i=0;i<n;i++){ pushFila(&fila, ev, NULL); ev = popFila(&fila, &running, NULL); }
+    } else {
+        pthread_t th;
+        pthread_create(&th, NULL, consumidor, &n);
+        for(long i=0;i<n;i++) pushFila(&fila, ev, NULL);
+        pthread_join(th, NULL);
+    }
+    return bench_agora() - t0;
+}
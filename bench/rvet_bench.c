@@ -0,0 +1,303 @@
+/**
+ * Benchmarks dos relógios, filas, codificação de mensagens e transporte das etapas
+ *
+ * Compilação: make (liga bench_e2.c, bench_e3.c e ../comum/libcomum.a)
+ * Execução: mpiexec -n 2 ./rvet_bench [-n iter] [-o csv|json]
+ *           ./rvet_bench [...]   (sem mpiexec: fim a fim só pelo transporte shm)
+ *
+ *   -n iter  operações por medida nos microbenchmarks (padrão 1000000; filas com
+ *            threads e fim a fim usam iter/10)
+ *   -o fmt   csv (padrão) ou json, uma linha/objeto por medida, com a versão do código
+ *
+ * As filas e o transporte medidos são os das próprias etapas: este arquivo inclui
+ * rvet_snapshot.c (FilaEvento, FilaMsg, FilaEnvio, Msg, Transporte mpi e shm) e
+ * bench_e2.c/bench_e3.c incluem pth_pool.c e rvet_pth.c, cada um com o main renomeado.
+ *
+ *   clock    Clock_max/Clock_compara (N fixo) contra vclock_max/vclock_compara (N dinâmico)
+ *   fila     push+pop alternados numa thread (_1t) e produtor/consumidor (_2t); a FilaMsg
+ *            move ponteiros e e4_pool_1t mede pegar+devolver um buffer do pool de Msg
+ *            (parâmetro: buffers no pool, já arredondado para potência de 2)
+ *   codec    Msg da Etapa 4 em bytes e de volta; relógio como MPI_INT (Etapas 1 e 3)
+ *   fim_a_fim  latência de ida (metade do ping-pong) e vazão do rank 0 ao 1
+ */
+
+#define main rvet_snapshot_main
+#include "../E4 - Snapshots de Chandy-Lamport/rvet_snapshot.c"
+#undef main
+#include "bench.h"
+
+#ifndef VERSAO
+#define VERSAO "desconhecida"
+#endif
+
+#define MAX_LINHAS 64
+
+typedef struct {
+    const char *grupo, *nome;
+    int param;
+    long iter;
+    double seg;
+} Linha;
+
+static Linha linhas[MAX_LINHAS];
+static int nlinhas;
+
+static void linha(const char *grupo, const char *nome, int param, long iter, double seg){
+    if(nlinhas < MAX_LINHAS) linhas[nlinhas++] = (Linha){grupo, nome, param, iter, seg};
+}
+
+//impede o compilador de descartar ou içar o trabalho medido
+static inline void escapa(const void *p){ __asm__ volatile("" : : "g"(p) : "memory"); }
+
+/* ---------------------------------- Relógio -------------------------------- */
+
+VCLOCK_DEF(Clock64, 64)
+
+static void bench_clock(long n){
+    Clock a = {{0}}, b = {{0}};
+    int da[1024] = {0}, db[1024] = {0};
+    Clock64 a64 = {{0}}, b64 = {{0}};
+    double t0;
+
+    t0 = agora();
+    for(long i=0;i<n;i++){ b.p[i % NUM_PROC]++; Clock_max(&a, &b); escapa(&a); }
+    linha("clock", "max_fixo", NUM_PROC, n, agora() - t0);
+    t0 = agora();
+    for(long i=0;i<n;i++){ db[i % NUM_PROC]++; vclock_max(da, db, NUM_PROC); escapa(da); }
+    linha("clock", "max_dinamico", NUM_PROC, n, agora() - t0);
+
+    int ordem = 0;
+    t0 = agora();
+    for(long i=0;i<n;i++){ b.p[i % NUM_PROC]++; ordem += Clock_compara(&a, &b); escapa(&b); }
+    linha("clock", "compara_fixo", NUM_PROC, n, agora() - t0);
+    t0 = agora();
+    for(long i=0;i<n;i++){ db[i % NUM_PROC]++; ordem += vclock_compara(da, db, NUM_PROC); escapa(db); }
+    linha("clock", "compara_dinamico", NUM_PROC, n, agora() - t0);
+    escapa(&ordem);
+
+    t0 = agora();
+    for(long i=0;i<n;i++){ b64.p[i & 63]++; Clock64_max(&a64, &b64); escapa(&a64); }
+    linha("clock", "max_fixo", 64, n, agora() - t0);
+    t0 = agora();
+    for(long i=0;i<n;i++){ db[i & 63]++; vclock_max(da, db, 64); escapa(da); }
+    linha("clock", "max_dinamico", 64, n, agora() - t0);
+    t0 = agora();
+    for(long i=0;i<n/16;i++){ db[i & 1023]++; vclock_max(da, db, 1024); escapa(da); }
+    linha("clock", "max_dinamico", 1024, n/16, agora() - t0);
+}
+
+/* ----------------------------------- Filas --------------------------------- */
+
+static FilaEvento fEv;
+static FilaMsg fMsg;
+static FilaEnvio fEnv;
+static volatile int running = 1;
+
+static void *cons_evento(void *arg){
+    long n = *(long*)arg;
+    for(long i=0;i<n;i++){ Evento ev = filaEvento_pop(&fEv, &running); escapa(&ev); }
+    return NULL;
+}
+static void *cons_msg(void *arg){
+    long n = *(long*)arg;
+    for(long i=0;i<n;i++){ filaMsg_wait(&fMsg, &running); Msg *m = filaMsg_tenta(&fMsg); escapa(m); }
+    return NULL;
+}
+static void *cons_envio(void *arg){
+    long n = *(long*)arg;
+    Envio e;
+    for(long i=0;i<n;i++){ while(!filaEnvio_pop(&fEnv, &e)) sched_yield(); escapa(&e); }
+    return NULL;
+}
+
+static void bench_filas(long n, long n2){
+    Evento ev = {ENVIO, 'b', 1, 'i'};
+    Msg m = {.type=MSG_NORMAL, .from=0, .to=1, .label='b'};
+    Envio e = {.dest=1, .tag=TAG_APP, .len=sizeof(Msg), .heap=NULL, .m=m};
+    pthread_t th;
+    double t0;
+
+    linha("fila", "e2_task_1t", 16, n, bench_e2_fila(n, 1));
+    linha("fila", "e2_task_2t", 16, n2, bench_e2_fila(n2, 2));
+    linha("fila", "e3_fila_1t", 10, n, bench_e3_fila(n, 1));
+    linha("fila", "e3_fila_2t", 10, n2, bench_e3_fila(n2, 2));
+
+    filaEvento_init(&fEv);
+    t0 = agora();
+    for(long i=0;i<n;i++){ filaEvento_push(&fEv, ev); ev = filaEvento_pop(&fEv, &running); }
+    linha("fila", "e4_evento_1t", MAX_QUEUE, n, agora() - t0);
+    t0 = agora();
+    pthread_create(&th, NULL, cons_evento, &n2);
+    for(long i=0;i<n2;i++) filaEvento_push(&fEv, ev);
+    pthread_join(th, NULL);
+    linha("fila", "e4_evento_2t", MAX_QUEUE, n2, agora() - t0);
+
+    filaMsg_init(&fMsg);
+    t0 = agora();
+    for(long i=0;i<n;i++){ filaMsg_push(&fMsg, &m); filaMsg_wait(&fMsg, &running); escapa(filaMsg_tenta(&fMsg)); }
+    linha("fila", "e4_msg_1t", MAX_QUEUE, n, agora() - t0);
+    t0 = agora();
+    pthread_create(&th, NULL, cons_msg, &n2);
+    for(long i=0;i<n2;i++) filaMsg_push(&fMsg, &m);
+    pthread_join(th, NULL);
+    linha("fila", "e4_msg_2t", MAX_QUEUE, n2, agora() - t0);
+
+    Pool pool;
+    pool_init(&pool, MAX_POOL, sizeof(Msg));
+    t0 = agora();
+    for(long i=0;i<n;i++){ void *b = pool_pega(&pool); escapa(b); pool_devolve(&pool, b); }
+    linha("fila", "e4_pool_1t", (int)pool.n, n, agora() - t0);
+    pool_libera(&pool);
+
+    filaEnvio_init(&fEnv);
+    t0 = agora();
+    for(long i=0;i<n;i++){ filaEnvio_push(&fEnv, &e); filaEnvio_pop(&fEnv, &e); }
+    linha("fila", "e4_envio_1t", MAX_SAIDA, n, agora() - t0);
+    t0 = agora();
+    pthread_create(&th, NULL, cons_envio, &n2);
+    for(long i=0;i<n2;i++) while(!filaEnvio_push(&fEnv, &e)) sched_yield();
+    pthread_join(th, NULL);
+    linha("fila", "e4_envio_2t", MAX_SAIDA, n2, agora() - t0);
+}
+
+/* -------------------------------- Codificação ------------------------------ */
+
+static void bench_codec(long n){
+    Msg m = {.type=MSG_NORMAL, .from=0, .to=1, .label='b'}, d;
+    char buf[sizeof(Msg)];
+    double t0;
+
+    //o transporte envia a Msg como bytes (MPI_BYTE ou cópia no anel shm)
+    t0 = agora();
+    for(long i=0;i<n;i++){
+        m.clock.p[i % NUM_PROC]++;
+        memcpy(buf, &m, sizeof(Msg)); escapa(buf);
+        memcpy(&d, buf, sizeof(Msg)); escapa(&d);
+    }
+    linha("codec", "e4_msg_bytes", (int)sizeof(Msg), n, agora() - t0);
+
+    //Etapas 1 e 3: só o vetor, como NUM_PROC MPI_INT
+    int pos, out[NUM_PROC];
+    t0 = agora();
+    for(long i=0;i<n;i++){
+        m.clock.p[i % NUM_PROC]++;
+        pos = 0; MPI_Pack(m.clock.p, NUM_PROC, MPI_INT, buf, sizeof(buf), &pos, MPI_COMM_WORLD); escapa(buf);
+        pos = 0; MPI_Unpack(buf, sizeof(buf), &pos, out, NUM_PROC, MPI_INT, MPI_COMM_WORLD); escapa(out);
+    }
+    linha("codec", "clock_mpi_int", NUM_PROC, n, agora() - t0);
+}
+
+/* -------------------------------- Fim a fim -------------------------------- */
+
+static void recv_espera(Transporte *tr, Msg *m){
+    while(!tr->recv(tr, TAG_APP, m, sizeof(Msg))) sched_yield();
+}
+
+//ranks 0 e 1 trocam Msg pelo transporte: ping-pong e depois fluxo contínuo com confirmação
+static void fim_a_fim(Transporte *tr, long n, double *lat, double *vaz){
+    Msg m = {.type=MSG_NORMAL, .label='b'};
+    int eu = tr->rank, outro = 1 - eu;
+    m.from = eu; m.to = outro;
+
+    double t0 = agora();
+    for(long i=0;i<n;i++){
+        if(eu == 0){ tr->send(tr, outro, TAG_APP, &m, sizeof(Msg)); recv_espera(tr, &m); }
+        else { recv_espera(tr, &m); tr->send(tr, outro, TAG_APP, &m, sizeof(Msg)); }
+    }
+    *lat = (agora() - t0) / 2;
+
+    t0 = agora();
+    if(eu == 0){
+        for(long i=0;i<n;i++){ m.clock.p[0] = i; tr->send(tr, outro, TAG_APP, &m, sizeof(Msg)); }
+        recv_espera(tr, &m);
+    } else {
+        for(long i=0;i<n;i++) recv_espera(tr, &m);
+        tr->send(tr, outro, TAG_APP, &m, sizeof(Msg));
+    }
+    *vaz = agora() - t0;
+}
+
+typedef struct { Transporte tr; long n; double lat, vaz; } ArgShm;
+
+static void *thread_shm(void *arg){
+    ArgShm *a = arg;
+    fim_a_fim(&a->tr, a->n, &a->lat, &a->vaz);
+    return NULL;
+}
+
+static void bench_shm(long n){
+    ShmMundo *w = calloc(1, sizeof(ShmMundo));
+    ShmRank r[2] = {{.w = w}, {.w = w}};
+    ArgShm a[2];
+    pthread_t th[2];
+    for(int i=0;i<2;i++){
+        transporte_shm(&a[i].tr, &r[i], i); a[i].n = n;
+        pthread_create(&th[i], NULL, thread_shm, &a[i]);
+    }
+    for(int i=0;i<2;i++) pthread_join(th[i], NULL);
+    linha("fim_a_fim", "shm_latencia", (int)sizeof(Msg), n, a[0].lat);
+    linha("fim_a_fim", "shm_vazao", (int)sizeof(Msg), n, a[0].vaz);
+    free(w);
+}
+
+/* ---------------------------------- Saída ---------------------------------- */
+
+static void imprime(int json){
+    if(json) printf("[\n");
+    else printf("versao,grupo,nome,param,iteracoes,ns_op,ops_s\n");
+    for(int i=0;i<nlinhas;i++){
+        Linha *l = &linhas[i];
+        double ns = l->seg * 1e9 / l->iter, ops = l->iter / l->seg;
+        if(json)
+            printf("  {\"versao\": \"%s\", \"grupo\": \"%s\", \"nome\": \"%s\", \"param\": %d, \"iteracoes\": %ld, \"ns_op\": %.2f, \"ops_s\": %.0f}%s\n",
+                   VERSAO, l->grupo, l->nome, l->param, l->iter, ns, ops, i+1 < nlinhas ? "," : "");
+        else printf("%s,%s,%s,%d,%ld,%.2f,%.0f\n", VERSAO, l->grupo, l->nome, l->param, l->iter, ns, ops);
+    }
+    if(json) printf("]\n");
+}
+
+int main(int argc, char **argv){
+    long n = 1000000;
+    int json = 0, opt, bad = 0;
+    while((opt = getopt(argc, argv, "n:o:")) != -1){
+        switch(opt){
+            case 'n': n = atol(optarg); break;
+            case 'o':
+                if(!strcmp(optarg, "csv")) json = 0;
+                else if(!strcmp(optarg, "json")) json = 1;
+                else bad = 1;
+                break;
+            default: bad = 1;
+        }
+    }
+    if(bad || n < 100){ fprintf(stderr, "uso: %s [-n iter] [-o csv|json]\n", argv[0]); return 1; }
+
+    //só a thread principal chama MPI; as do shm e das filas não
+    int provided = 0, rank, size;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    if(rank == 0){
+        bench_clock(n);
+        bench_filas(n, n/10);
+        bench_codec(n);
+        bench_shm(n/10);
+    }
+    if(size >= 2){
+        MPI_Barrier(MPI_COMM_WORLD);
+        if(rank < 2){
+            Transporte tr; transporte_mpi(&tr);
+            double lat, vaz;
+            fim_a_fim(&tr, n/10, &lat, &vaz);
+            if(rank == 0){
+                linha("fim_a_fim", "mpi_latencia", (int)sizeof(Msg), n/10, lat);
+                linha("fim_a_fim", "mpi_vazao", (int)sizeof(Msg), n/10, vaz);
+            }
+        }
+    }
+    if(rank == 0) imprime(json);
+
+    MPI_Finalize();
+    return 0;
+}
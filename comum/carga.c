@@ -0,0 +1,148 @@
+/**
+ * Gerador de cargas sintéticas
+ * Ver carga.h
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "carga.h"
+
+static const Evento fixo_p0[] = {
+    {EVENTO, 'a', -1, 0},
+    {ENVIO,  'b', 1, 'i'},
+    {RECEBIMENTO, 'c', 1, 'h'},
+    {ENVIO,  'd', 2, 'm'},
+    {RECEBIMENTO, 'e', 2, 'l'},
+    {ENVIO,  'f', 1, 'j'},
+    {EVENTO, 'g', -1, 0}
+};
+static const Evento fixo_p1[] = {
+    {ENVIO, 'h', 0, 'c'},
+    {RECEBIMENTO, 'i', 0, 'b'},
+    {RECEBIMENTO, 'j', 0, 'f'}
+};
+static const Evento fixo_p2[] = {
+    {EVENTO, 'k', -1, 0},
+    {ENVIO,  'l', 0, 'e'},
+    {RECEBIMENTO, 'm', 0, 'd'}
+};
+
+static const char *nomes[] = { "fixo", "anel", "todos", "aleatorio", "estrela", "rajada" };
+
+void carga_init(Carga *c, int nprocs){
+    c->padrao = CARGA_FIXA; c->nprocs = nprocs;
+    c->eventos = 1000; c->interno = 0.5; c->rajada = 8; c->seed = 1;
+}
+
+int carga_padrao(Carga *c, const char *nome){
+    for(int i=0;i<(int)(sizeof(nomes)/sizeof(nomes[0]));i++)
+        if(!strcmp(nome, nomes[i])){ c->padrao = (PadraoCarga)i; return 1; }
+    return 0;
+}
+
+//mensagem enviada e ainda não recebida na ordem global
+typedef struct { int src; long idx; char label; } Pend;
+
+typedef struct {
+    const Carga *c;
+    int pid;
+    Evento *out; long n, cap;
+    long *cont; //eventos emitidos por processo (rótulos)
+    long *k; //rodízio de destinos (todos, estrela) ou fase da rajada
+    Pend *pend; int *pend_ini, *pend_n;
+    unsigned x; //xorshift32: mesma sequência em todos os processos
+} Gerador;
+
+static unsigned aleatorio(Gerador *g){
+    g->x ^= g->x << 13; g->x ^= g->x >> 17; g->x ^= g->x << 5;
+    return g->x;
+}
+
+//anexa o evento à linha do tempo de 'r' (guardada só se r == pid); devolve o rótulo
+static char emite(Gerador *g, int r, TipoEvento tipo, int outro, char outroLabel, long *idx){
+    char label = 'a' + g->cont[r]++ % 26;
+    *idx = -1;
+    if(r != g->pid) return label;
+    if(g->n == g->cap){ g->cap = g->cap ? 2*g->cap : 64; g->out = realloc(g->out, g->cap * sizeof(Evento)); }
+    g->out[g->n] = (Evento){tipo, label, outro, outroLabel};
+    *idx = g->n++;
+    return label;
+}
+
+static void recebe_um(Gerador *g, int d){
+    Pend p = g->pend[d*CARGA_MAX_PEND + g->pend_ini[d]];
+    g->pend_ini[d] = (g->pend_ini[d] + 1) % CARGA_MAX_PEND; g->pend_n[d]--;
+    long idx;
+    char label = emite(g, d, RECEBIMENTO, p.src, p.label, &idx);
+    //o envio correspondente fica sabendo o rótulo do recebimento
+    if(p.idx >= 0) g->out[p.idx].outroLabel = label;
+}
+
+static void recebe_todos(Gerador *g, int d){
+    while(g->pend_n[d] > 0) recebe_um(g, d);
+}
+
+static void envia(Gerador *g, int a, int d){
+    long idx;
+    char label = emite(g, a, ENVIO, d, 0, &idx);
+    int pos = (g->pend_ini[d] + g->pend_n[d]++) % CARGA_MAX_PEND;
+    g->pend[d*CARGA_MAX_PEND + pos] = (Pend){a, idx, label};
+    if(g->pend_n[d] == CARGA_MAX_PEND) recebe_um(g, d);
+}
+
+//destino da próxima ação de 'a', ou -1 para evento interno
+static int acao(Gerador *g, int a){
+    const Carga *c = g->c;
+    int n = c->nprocs;
+    if(c->padrao == CARGA_RAJADA){
+        //fase < rajada: envio; depois internos na proporção 'interno'
+        long quietos = c->interno >= 1 ? 0 : (long)(c->rajada * c->interno / (1 - c->interno) + 0.5);
+        long fase = g->k[a]; g->k[a] = (fase + 1) % (c->rajada + quietos);
+        if(c->interno >= 1 || fase >= c->rajada) return -1;
+    } else if((aleatorio(g) & 0xffffff) < c->interno * 0x1000000) return -1;
+
+    switch(c->padrao){
+        case CARGA_ANEL: return (a + 1) % n;
+        case CARGA_TODOS: return (a + 1 + g->k[a]++ % (n - 1)) % n;
+        case CARGA_ESTRELA: return a == 0 ? 1 + g->k[0]++ % (n - 1) : 0;
+        default: {
+            int d = aleatorio(g) % (n - 1);
+            return d >= a ? d + 1 : d;
+        }
+    }
+}
+
+Evento *carga_gerar(const Carga *c, int pid, int *count){
+    *count = 0;
+    if(c->padrao == CARGA_FIXA){
+        if(c->nprocs != 3) return NULL;
+        const Evento *src = pid==0 ? fixo_p0 : pid==1 ? fixo_p1 : fixo_p2;
+        int n = pid==0 ? sizeof(fixo_p0)/sizeof(Evento) : pid==1 ? sizeof(fixo_p1)/sizeof(Evento) : sizeof(fixo_p2)/sizeof(Evento);
+        Evento *out = malloc(n * sizeof(Evento));
+        memcpy(out, src, n * sizeof(Evento));
+        *count = n;
+        return out;
+    }
+    if(c->nprocs < 2 || c->eventos < 1 || c->rajada < 1) return NULL;
+
+    int n = c->nprocs;
+    Gerador g = { .c = c, .pid = pid, .x = c->seed ? c->seed : 1 };
+    g.cont = calloc(n, sizeof(long)); g.k = calloc(n, sizeof(long));
+    g.pend = malloc((size_t)n * CARGA_MAX_PEND * sizeof(Pend));
+    g.pend_ini = calloc(n, sizeof(int)); g.pend_n = calloc(n, sizeof(int));
+
+    //ações em rodízio: cada processo faz exatamente 'eventos' ações
+    for(long passo=0; passo < c->eventos * n; passo++){
+        int a = passo % n;
+        recebe_todos(&g, a);
+        int d = acao(&g, a);
+        long idx;
+        if(d < 0) emite(&g, a, EVENTO, -1, 0, &idx);
+        else envia(&g, a, d);
+    }
+    for(int r=0;r<n;r++) recebe_todos(&g, r);
+
+    free(g.cont); free(g.k); free(g.pend); free(g.pend_ini); free(g.pend_n);
+    *count = g.n;
+    return g.out;
+}
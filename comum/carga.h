@@ -0,0 +1,57 @@
+/**
+ * Gerador de cargas sintéticas: linha do tempo (Evento) de cada processo
+ *
+ * Todos os processos geram a mesma ordem global com a mesma semente e cada um fica
+ * com a sua projeção. Na ordem global todo RECEBIMENTO vem depois do ENVIO que o
+ * alimenta, então com canais sem limite a execução termina. Nessa ordem um destino não
+ * acumula mais de CARGA_MAX_PEND mensagens não recebidas, mas numa intercalação real
+ * os remetentes podem se adiantar: com filas de entrada limitadas e envio bloqueante
+ * não há garantia de término.
+ *
+ *   fixo       o diagrama de 3 processos das etapas (exige 3 processos)
+ *   anel       envio ao sucessor
+ *   todos      cada processo percorre todos os outros em rodízio
+ *   aleatorio  destino uniforme entre os outros
+ *   estrela    folhas enviam ao P0, que responde às folhas em rodízio
+ *   rajada     rajadas de 'rajada' envios aleatórios separadas por eventos internos
+ *
+ * 'eventos' conta as ações de cada processo (internos e envios); os recebimentos
+ * vêm a mais. 'interno' é a fração das ações que são eventos internos.
+ */
+
+#ifndef CARGA_H
+#define CARGA_H
+
+//pendências por destino na ordem global do gerador; as etapas usam como dimensionamento
+//heurístico da fila de entrada (#error se a fila for menor), não como limite de execução
+#define CARGA_MAX_PEND 8
+
+typedef enum { EVENTO, ENVIO, RECEBIMENTO } TipoEvento;
+
+typedef struct Evento {
+    TipoEvento tipo;
+    char label;
+    int destino_ou_origem;
+    char outroLabel;
+} Evento;
+
+typedef enum { CARGA_FIXA, CARGA_ANEL, CARGA_TODOS, CARGA_ALEATORIA, CARGA_ESTRELA, CARGA_RAJADA } PadraoCarga;
+
+typedef struct Carga {
+    PadraoCarga padrao;
+    int nprocs;
+    long eventos;
+    double interno;
+    int rajada;
+    unsigned seed;
+} Carga;
+
+#define CARGA_NOMES "fixo|anel|todos|aleatorio|estrela|rajada"
+
+void carga_init(Carga *c, int nprocs);
+//devolve 0 se o nome não é um padrão conhecido
+int carga_padrao(Carga *c, const char *nome);
+//vetor alocado com malloc; NULL se a carga não serve para c->nprocs
+Evento *carga_gerar(const Carga *c, int pid, int *count);
+
+#endif
@@ -0,0 +1,100 @@
+/**
+ * Gravação e reprodução determinística
+ * Ver gravacao.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "gravacao.h"
+
+void grav_init(Gravacao *g, GravModo modo, const char *arq){
+    g->modo = modo; g->arq = arq;
+    g->passos = NULL; g->n = g->cap = 0;
+}
+
+void grav_libera(Gravacao *g){
+    free(g->passos);
+    g->passos = NULL; g->n = g->cap = 0;
+}
+
+void grav_cresce(Gravacao *g){
+    g->cap = g->cap ? 2 * g->cap : 4096;
+    g->passos = realloc(g->passos, g->cap * sizeof(int));
+    if(!g->passos){ perror("gravação"); exit(1); }
+}
+
+static void nome_arq(const Gravacao *g, int pid, char *nome, size_t tam){
+    snprintf(nome, tam, "%s.%d", g->arq, pid);
+}
+
+int grav_salva(const Gravacao *g, int pid, const Carga *c){
+    char nome[600];
+    nome_arq(g, pid, nome, sizeof(nome));
+    FILE *f = fopen(nome, "w");
+    if(!f){ perror(nome); return 0; }
+    static _Thread_local char buf[1 << 16];
+    setvbuf(f, buf, _IOFBF, sizeof(buf));
+    fprintf(f, "rvet-gravacao %d %d %d %ld %.17g %d %u %ld\n",
+            c->nprocs, pid, (int)c->padrao, c->eventos, c->interno, c->rajada, c->seed, g->n);
+    for(long k=0;k<g->n;k++){
+        int p = g->passos[k];
+        if(p == GRAV_EVENTO) fputs("e\n", f);
+        else if(p == GRAV_ENVIO) fputs("s\n", f);
+        else fprintf(f, "r %d\n", p);
+    }
+    int ok = !ferror(f);
+    if(fclose(f) || !ok){ perror(nome); return 0; }
+    return 1;
+}
+
+//a sequência de internos e recebimentos é a da linha do tempo; envios em mesmo número
+static int casa_carga(const Gravacao *g, int pid, const Carga *c){
+    int count;
+    Evento *lista = carga_gerar(c, pid, &count);
+    if(!lista) return 0;
+    long k = 0, envios = 0, gravados = 0;
+    int ok = 1;
+    for(int i=0;i<count && ok;i++){
+        if(lista[i].tipo == ENVIO){ envios++; continue; }
+        k = grav_proximo(g, k, GRAV_BIT(EVENTO) | GRAV_BIT(RECEBIMENTO));
+        ok = k < g->n && grav_tipo(g->passos[k]) == lista[i].tipo
+                      && (lista[i].tipo == EVENTO || g->passos[k] < c->nprocs);
+        k++;
+    }
+    for(long j=0;j<g->n;j++) gravados += g->passos[j] == GRAV_ENVIO;
+    free(lista);
+    return ok && envios == gravados && grav_proximo(g, k, GRAV_BIT(EVENTO) | GRAV_BIT(RECEBIMENTO)) == g->n;
+}
+
+int grav_carrega(Gravacao *g, int pid, const Carga *c){
+    char nome[600];
+    nome_arq(g, pid, nome, sizeof(nome));
+    FILE *f = fopen(nome, "r");
+    if(!f){ perror(nome); return 0; }
+    int nprocs, rank, padrao, rajada; long eventos, n; double interno; unsigned seed;
+    int ok = fscanf(f, "rvet-gravacao %d %d %d %ld %lg %d %u %ld", &nprocs, &rank, &padrao,
+                    &eventos, &interno, &rajada, &seed, &n) == 8 && n >= 0;
+    if(!ok) fprintf(stderr, "%s: não é uma gravação\n", nome);
+    else if(nprocs != c->nprocs || rank != pid || padrao != (int)c->padrao || eventos != c->eventos
+            || interno != c->interno || rajada != c->rajada || seed != c->seed){
+        fprintf(stderr, "%s: gravada com outra carga ou outro processo (%d processos, P%d, -W %d -e %ld -i %g -b %d -s %u)\n",
+                nome, nprocs, rank, padrao, eventos, interno, rajada, seed);
+        ok = 0;
+    }
+    grav_libera(g);
+    for(long k=0;ok && k<n;k++){
+        char t = 0; int de = GRAV_EVENTO;
+        ok = fscanf(f, " %c", &t) == 1 && (t == 'e' || t == 's' || (t == 'r' && fscanf(f, "%d", &de) == 1 && de >= 0));
+        if(t == 's') de = GRAV_ENVIO;
+        if(g->n == g->cap) grav_cresce(g);
+        g->passos[g->n++] = de;
+    }
+    fclose(f);
+    if(!ok && g->n) fprintf(stderr, "%s: passo %ld ilegível\n", nome, g->n);
+    if(ok && !casa_carga(g, pid, c)){
+        fprintf(stderr, "%s: os passos não casam com a linha do tempo de P%d\n", nome, pid);
+        ok = 0;
+    }
+    if(!ok) grav_libera(g);
+    return ok;
+}
@@ -0,0 +1,63 @@
+/**
+ * Gravação e reprodução determinística de uma execução (E3 e E4)
+ *
+ * Gravar (-r arq): cada processo anota, na ordem em que a sua entrada do relógio
+ * avança, o tipo de cada passo: evento interno, envio, ou recebimento com o
+ * remetente da mensagem entregue. É um int por passo num vetor em memória, anotado
+ * sob a trava que já protege o relógio; o arquivo <arq>.<pid> só é escrito no fim.
+ *
+ * Reproduzir (-y arq): o passo k (a entrada própria do relógio vai de k para k+1)
+ * só acontece na sua vez, e o recebimento entrega a primeira mensagem do remetente
+ * gravado. Canais são FIFO, então o remetente basta para saber qual mensagem; a vez
+ * fixa também a intercalação dos envios da threadSaida com os passos da
+ * threadRelogio. Mesma carga e mesma gravação dão os mesmos relógios, e as etapas
+ * dispensam as esperas artificiais (usleep da carga fixa) ao reproduzir.
+ *
+ * O cabeçalho guarda a carga; grav_carrega recusa uma gravação feita com outra
+ * carga ou que não casa com a linha do tempo do processo.
+ */
+
+#ifndef GRAVACAO_H
+#define GRAVACAO_H
+
+#include "carga.h"
+
+typedef enum { GRAV_NADA, GRAV_GRAVA, GRAV_REPRODUZ } GravModo;
+
+//passos: >= 0 é recebimento (valor = remetente)
+enum { GRAV_EVENTO = -1, GRAV_ENVIO = -2 };
+#define GRAV_BIT(tipo) (1 << (tipo))
+
+typedef struct Gravacao {
+    GravModo modo;
+    const char *arq; //prefixo; cada processo usa <arq>.<pid>
+    int *passos;
+    long n, cap;
+} Gravacao;
+
+void grav_init(Gravacao *g, GravModo modo, const char *arq);
+void grav_libera(Gravacao *g);
+//0 se não pôde escrever (mensagem em stderr)
+int grav_salva(const Gravacao *g, int pid, const Carga *c);
+//0 se o arquivo falta, é de outra carga ou não casa com a linha do tempo de pid
+int grav_carrega(Gravacao *g, int pid, const Carga *c);
+
+void grav_cresce(Gravacao *g);
+
+static inline void grav_anota(Gravacao *g, int passo){
+    if(g->modo != GRAV_GRAVA) return;
+    if(g->n == g->cap) grav_cresce(g);
+    g->passos[g->n++] = passo;
+}
+
+static inline TipoEvento grav_tipo(int passo){
+    return passo >= 0 ? RECEBIMENTO : passo == GRAV_ENVIO ? ENVIO : EVENTO;
+}
+
+//índice do primeiro passo a partir de 'de' com tipo em 'tipos' (GRAV_BIT); n se acabou
+static inline long grav_proximo(const Gravacao *g, long de, int tipos){
+    while(de < g->n && !(tipos & GRAV_BIT(grav_tipo(g->passos[de])))) de++;
+    return de;
+}
+
+#endif
@@ -0,0 +1,192 @@
+/**
+ * Métricas de execução: áreas por thread, publicação e leitura
+ * Ver metricas.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include "metricas.h"
+
+static _Atomic(MetArea *) areas;  //topo da lista; áreas só entram, nunca saem
+static atomic_int n_areas;
+_Thread_local MetArea *met_eu;
+
+static volatile sig_atomic_t pedido;  //SIGUSR1 recebido
+static atomic_int parar;
+static pthread_t publicador;
+static int ativo;
+static MetResumo *publicado;           //região compartilhada (NULL se shm_open falhou)
+static char nome_shm[64];
+static char programa[32];
+static uint64_t t0;
+
+static const char *nomes_fila[] = MET_FILA_NOMES;
+static const char *nomes_cont[] = MET_CONT_NOMES;
+static const char *nomes_hist[] = MET_HIST_NOMES;
+
+MetArea *met_area_nova(void) {
+    MetArea *a = aligned_alloc(64, sizeof(MetArea));
+    if (!a) { perror("métricas"); exit(1); }
+    memset(a, 0, sizeof(*a));
+    //push sem trava: met_soma pode estar percorrendo a lista
+    MetArea *topo = atomic_load(&areas);
+    do a->prox = topo; while (!atomic_compare_exchange_weak(&areas, &topo, a));
+    atomic_fetch_add(&n_areas, 1);
+    met_eu = a;
+    return a;
+}
+
+void met_soma(MetResumo *r) {
+    memset(r, 0, sizeof(*r));
+    r->pid = (long)getpid();
+    memcpy(r->programa, programa, sizeof(r->programa));
+    r->instante = (met_ns() - t0) / 1e9;
+    r->threads = atomic_load(&n_areas);
+    for (MetArea *a = atomic_load(&areas); a; a = a->prox) {
+        for (int f = 0; f < MF_N; f++)
+            for (int c = 0; c < MFC_N; c++) {
+                long v = atomic_load_explicit(&a->fila[f][c], memory_order_relaxed);
+                if (c == MFC_PROF_MAX) { if (v > r->fila[f][c]) r->fila[f][c] = v; }
+                else r->fila[f][c] += v;
+            }
+        for (int c = 0; c < MC_N; c++) r->cont[c] += atomic_load_explicit(&a->cont[c], memory_order_relaxed);
+        for (int h = 0; h < MH_N; h++)
+            for (int b = 0; b < MET_BALDES; b++)
+                r->hist[h][b] += atomic_load_explicit(&a->hist[h][b], memory_order_relaxed);
+    }
+}
+
+//valor (limite inferior do balde) abaixo do qual está a fração q das amostras
+static uint64_t percentil(const long *hist, long total, double q) {
+    long alvo = (long)(q * total), acc = 0;
+    for (int b = 0; b < MET_BALDES; b++) {
+        acc += hist[b];
+        if (acc > alvo) return met_balde_valor(b);
+    }
+    return 0;
+}
+
+void met_imprime(FILE *out, const MetResumo *r) {
+    char buf[8192];
+    int n = snprintf(buf, sizeof(buf), "== métricas %s (pid %ld, %.1f s, %d threads) ==\n",
+                     r->programa, r->pid, r->instante, r->threads);
+    for (int f = 0; f < MF_N; f++) {
+        const long *c = r->fila[f];
+        if (!c[MFC_PUSH] && !c[MFC_POP]) continue;
+        n += snprintf(buf + n, sizeof(buf) - n,
+                      "fila %-8s push %ld pop %ld bloqueios push %ld pop %ld profundidade média %.2f máx %ld\n",
+                      nomes_fila[f], c[MFC_PUSH], c[MFC_POP], c[MFC_PUSH_BLOQ], c[MFC_POP_BLOQ],
+                      c[MFC_PUSH] ? (double)c[MFC_PROF_SOMA] / c[MFC_PUSH] : 0.0, c[MFC_PROF_MAX]);
+    }
+    for (int c = 0; c < MC_N; c++)
+        n += snprintf(buf + n, sizeof(buf) - n, "%s %ld%s", nomes_cont[c], r->cont[c], c == MC_N - 1 ? "\n" : "  ");
+    if (r->instante > 0)
+        n += snprintf(buf + n, sizeof(buf) - n, "taxa: %.0f msgs/s enviadas, %.0f msgs/s recebidas\n",
+                      r->cont[MC_MSG_ENV] / r->instante, r->cont[MC_MSG_REC] / r->instante);
+    for (int h = 0; h < MH_N; h++) {
+        long total = 0, max = -1;
+        for (int b = 0; b < MET_BALDES; b++) if (r->hist[h][b]) { total += r->hist[h][b]; max = b; }
+        if (!total) continue;
+        n += snprintf(buf + n, sizeof(buf) - n, "%-20s n %ld p50 %lu p90 %lu p99 %lu p999 %lu máx %lu ns\n",
+                      nomes_hist[h], total,
+                      (unsigned long)percentil(r->hist[h], total, 0.50), (unsigned long)percentil(r->hist[h], total, 0.90),
+                      (unsigned long)percentil(r->hist[h], total, 0.99), (unsigned long)percentil(r->hist[h], total, 0.999),
+                      (unsigned long)met_balde_valor(max));
+    }
+    fputs(buf, out);
+    fflush(out);
+}
+
+//seqlock: leitores repetem enquanto seq é ímpar ou mudou durante a cópia
+static void publica(void) {
+    if (!publicado) return;
+    MetResumo r;
+    met_soma(&r);
+    atomic_fetch_add_explicit(&publicado->seq, 1, memory_order_acq_rel);
+    memcpy((char*)publicado + sizeof(publicado->seq), (char*)&r + sizeof(r.seq), sizeof(r) - sizeof(r.seq));
+    atomic_fetch_add_explicit(&publicado->seq, 1, memory_order_release);
+}
+
+static void on_usr1(int sig) { (void)sig; pedido = 1; }
+
+static void *threadPublica(void *arg) {
+    (void)arg;
+    struct timespec passo = {0, 50 * 1000000L};
+    int ciclos = 0;
+    while (!atomic_load(&parar)) {
+        nanosleep(&passo, NULL);
+        if (pedido) {
+            pedido = 0;
+            MetResumo r;
+            met_soma(&r);
+            met_imprime(stderr, &r);
+        }
+        if (++ciclos * 50 >= MET_PERIODO_MS) { ciclos = 0; publica(); }
+    }
+    return NULL;
+}
+
+void met_init(const char *prog) {
+    if (ativo) return;
+    ativo = 1;
+    t0 = met_ns();
+    strncpy(programa, prog, sizeof(programa) - 1);
+
+    snprintf(nome_shm, sizeof(nome_shm), "/rvet_met.%ld", (long)getpid());
+    int fd = shm_open(nome_shm, O_CREAT | O_RDWR, 0644);
+    if (fd >= 0 && ftruncate(fd, sizeof(MetResumo)) == 0) {
+        void *p = mmap(NULL, sizeof(MetResumo), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        publicado = p == MAP_FAILED ? NULL : p;
+    }
+    if (fd >= 0) close(fd);
+    if (!publicado) fprintf(stderr, "métricas: sem região %s, só SIGUSR1\n", nome_shm);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_usr1;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1, &sa, NULL);
+
+    pthread_create(&publicador, NULL, threadPublica, NULL);
+}
+
+void met_fim(void) {
+    if (!ativo) return;
+    atomic_store(&parar, 1);
+    pthread_join(publicador, NULL);
+    MetResumo r;
+    met_soma(&r);
+    met_imprime(stderr, &r);
+    if (publicado) {
+        munmap(publicado, sizeof(MetResumo));
+        shm_unlink(nome_shm);
+        publicado = NULL;
+    }
+    ativo = 0;
+}
+
+int met_le(long pid, MetResumo *r) {
+    char nome[64];
+    snprintf(nome, sizeof(nome), "/rvet_met.%ld", pid);
+    int fd = shm_open(nome, O_RDONLY, 0);
+    if (fd < 0) return 0;
+    MetResumo *p = mmap(NULL, sizeof(MetResumo), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return 0;
+    unsigned long s1, s2;
+    do {
+        s1 = atomic_load_explicit(&p->seq, memory_order_acquire);
+        memcpy((char*)r + sizeof(r->seq), (const char*)p + sizeof(p->seq), sizeof(*r) - sizeof(r->seq));
+        atomic_thread_fence(memory_order_acquire);
+        s2 = atomic_load_explicit(&p->seq, memory_order_relaxed);
+    } while ((s1 & 1) || s1 != s2);
+    munmap(p, sizeof(MetResumo));
+    return s1 > 0;
+}
@@ -0,0 +1,26 @@
+/**
+ * Pool de buffers de mensagem
+ * Ver pool.h
+ */
+
+#include <stdlib.h>
+#include "pool.h"
+
+int pool_init(Pool *p, unsigned n, size_t tam){
+    unsigned k = 1;
+    while(k < n) k <<= 1;
+    p->n = k;
+    p->tam = (tam + 63) & ~(size_t)63;
+    p->area = aligned_alloc(64, (size_t)k * p->tam);
+    p->livres = malloc(k * sizeof(void*));
+    if(!p->area || !p->livres){ free(p->area); free(p->livres); p->area = NULL; p->livres = NULL; return 0; }
+    for(unsigned i=0;i<k;i++) p->livres[i] = p->area + (size_t)i * p->tam;
+    atomic_init(&p->cabeca, 0);
+    atomic_init(&p->cauda, k);
+    return 1;
+}
+
+void pool_libera(Pool *p){
+    free(p->area); free(p->livres);
+    p->area = NULL; p->livres = NULL;
+}
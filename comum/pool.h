@@ -0,0 +1,49 @@
+/**
+ * Pool de buffers de mensagem de tamanho fixo, sem trava
+ *
+ * Uma thread retira (a de recepção, que recebe direto no buffer) e uma devolve (a
+ * da aplicação, depois da entrega); entre as duas só anda o ponteiro, pela fila de
+ * entrada da etapa. Os buffers livres ficam num anel SPSC com exatamente n posições:
+ * como só existem n buffers, a devolução nunca encontra o anel cheio.
+ *
+ * pool_pega devolve NULL com o pool vazio: a recepção trata como "nada a receber" e
+ * tenta de novo, o que limita a memória em vez de bloquear. Dimensione n acima do
+ * que pode estar retido ao mesmo tempo (fila de entrada + um por thread).
+ *
+ * Cada buffer ocupa um múltiplo de 64 bytes: buffers vizinhos não dividem linha.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+typedef struct Pool {
+    void **livres; //anel com os buffers disponíveis
+    char *area;
+    unsigned n; //potência de 2
+    size_t tam;
+    _Alignas(64) atomic_uint cabeca; //só pool_pega escreve
+    _Alignas(64) atomic_uint cauda; //só pool_devolve escreve
+} Pool;
+
+//n é arredondado para potência de 2; 0 se faltou memória
+int pool_init(Pool *p, unsigned n, size_t tam);
+void pool_libera(Pool *p);
+
+static inline void *pool_pega(Pool *p){
+    unsigned h = atomic_load_explicit(&p->cabeca, memory_order_relaxed);
+    if(h == atomic_load_explicit(&p->cauda, memory_order_acquire)) return NULL;
+    void *b = p->livres[h & (p->n - 1)];
+    atomic_store_explicit(&p->cabeca, h + 1, memory_order_release);
+    return b;
+}
+
+static inline void pool_devolve(Pool *p, void *b){
+    unsigned t = atomic_load_explicit(&p->cauda, memory_order_relaxed);
+    p->livres[t & (p->n - 1)] = b;
+    atomic_store_explicit(&p->cauda, t + 1, memory_order_release);
+}
+
+#endif
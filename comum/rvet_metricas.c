@@ -0,0 +1,31 @@
+/**
+ * Leitor das métricas publicadas por uma etapa compilada com METRICAS=1
+ *
+ * Compilação: make (gera rvet_metricas)
+ * Execução:   ./rvet_metricas <pid> [intervalo_s]
+ *             sem intervalo imprime uma vez; com intervalo repete até o processo sair
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "metricas.h"
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "uso: %s <pid> [intervalo_s]\n", argv[0]);
+        return 1;
+    }
+    long pid = atol(argv[1]);
+    int intervalo = argc > 2 ? atoi(argv[2]) : 0;
+    static MetResumo r;
+    do {
+        if (!met_le(pid, &r)) {
+            fprintf(stderr, "sem métricas publicadas pelo pid %ld\n", pid);
+            return 1;
+        }
+        met_imprime(stdout, &r);
+        if (intervalo > 0) sleep(intervalo);
+    } while (intervalo > 0);
+    return 0;
+}
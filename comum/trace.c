@@ -0,0 +1,161 @@
+/**
+ * Trace Chrome/Perfetto: buffers por thread e escrita no fim
+ * Ver trace.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "trace.h"
+
+#define TRACE_BLOCO (1 << 20)
+
+typedef struct {
+    uint64_t ts, dur, id;
+    const char *nome;
+    int tid, n;        //n ints de relógio logo após o registro
+    char fase, label, outro;
+} Registro;
+
+typedef struct Bloco {
+    struct Bloco *prox;
+    size_t usado;
+    _Alignas(8) char dados[TRACE_BLOCO];
+} Bloco;
+
+typedef struct Buffer {
+    struct Buffer *prox;
+    int rank, tid;
+    const char *nome;
+    Bloco *primeiro, *atual;
+} Buffer;
+
+int trace_ativo;
+static char arquivo[512];
+static Buffer *buffers;
+static pthread_mutex_t buffers_m = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local Buffer *meu;
+
+int trace_init(const char *arq) {
+    FILE *f = fopen(arq, "w");
+    if (!f) return 0;
+    fclose(f);
+    snprintf(arquivo, sizeof(arquivo), "%s", arq);
+    trace_ativo = 1;
+    return 1;
+}
+
+void trace_thread(int rank, int tid, const char *nome) {
+    if (!trace_ativo) return;
+    Buffer *b = calloc(1, sizeof(Buffer));
+    b->rank = rank; b->tid = tid; b->nome = nome;
+    pthread_mutex_lock(&buffers_m);
+    b->prox = buffers; buffers = b;
+    pthread_mutex_unlock(&buffers_m);
+    meu = b;
+}
+
+static Registro *reserva(int n) {
+    Buffer *b = meu;
+    if (!b) return NULL;  //thread sem trace_thread
+    size_t tam = (sizeof(Registro) + n * sizeof(int) + 7) & ~(size_t)7;
+    if (!b->atual || b->atual->usado + tam > TRACE_BLOCO) {
+        Bloco *novo = malloc(sizeof(Bloco));
+        novo->prox = NULL; novo->usado = 0;
+        if (b->atual) b->atual->prox = novo; else b->primeiro = novo;
+        b->atual = novo;
+    }
+    Registro *r = (Registro*)(b->atual->dados + b->atual->usado);
+    b->atual->usado += tam;
+    r->n = n;
+    return r;
+}
+
+void trace_fatia(int tid, const char *nome, uint64_t t0, uint64_t t1, char label, char outro,
+                 const int *clock, int n) {
+    Registro *r = reserva(clock ? n : 0);
+    if (!r) return;
+    r->fase = 'X'; r->ts = t0; r->dur = t1 - t0; r->id = 0;
+    r->nome = nome; r->tid = tid < 0 ? meu->tid : tid; r->label = label; r->outro = outro;
+    if (clock) memcpy(r + 1, clock, n * sizeof(int));
+}
+
+void trace_fluxo(char fase, uint64_t id, uint64_t ts) {
+    Registro *r = reserva(0);
+    if (!r) return;
+    r->fase = fase; r->ts = ts; r->dur = 0; r->id = id;
+    r->nome = "msg"; r->tid = meu->tid; r->label = r->outro = 0;
+}
+
+static void escreve(FILE *f, const Buffer *b, const Registro *r) {
+    double ts = r->ts / 1000.0;
+    if (r->fase != 'X') {
+        fprintf(f, "{\"name\":\"msg\",\"cat\":\"msg\",\"ph\":\"%c\",%s\"id\":\"0x%llx\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d},\n",
+                r->fase, r->fase == 'f' ? "\"bp\":\"e\"," : "", (unsigned long long)r->id, ts, b->rank, r->tid);
+        return;
+    }
+    fprintf(f, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{",
+            r->nome, ts, r->dur / 1000.0, b->rank, r->tid);
+    int v = 0;
+    if (r->label) { fprintf(f, "\"label\":\"%c\"", r->label); v = 1; }
+    if (r->outro) { fprintf(f, "%s\"outro\":\"%c\"", v ? "," : "", r->outro); v = 1; }
+    if (r->n) {
+        const int *c = (const int*)(r + 1);
+        fprintf(f, "%s\"clock\":\"(", v ? "," : "");
+        for (int i = 0; i < r->n; i++) fprintf(f, i ? ",%d" : "%d", c[i]);
+        fputs(")\"", f);
+    }
+    fputs("}},\n", f);
+}
+
+void trace_fim(int parte) {
+    if (!trace_ativo) return;
+    char nome[600];
+    snprintf(nome, sizeof(nome), "%s.%d", arquivo, parte);
+    FILE *f = fopen(nome, "w");
+    if (!f) { perror(nome); return; }
+    static char buf[1 << 16];
+    setvbuf(f, buf, _IOFBF, sizeof(buf));
+    pthread_mutex_lock(&buffers_m);
+    for (Buffer *b = buffers; b; b = b->prox) {
+        fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n",
+                b->rank, b->tid, b->nome);
+        for (Bloco *k = b->primeiro; k; k = k->prox)
+            for (size_t o = 0; o < k->usado; ) {
+                const Registro *r = (const Registro*)(k->dados + o);
+                escreve(f, b, r);
+                o += (sizeof(Registro) + r->n * sizeof(int) + 7) & ~(size_t)7;
+            }
+    }
+    while (buffers) {
+        Buffer *b = buffers; buffers = b->prox;
+        while (b->primeiro) { Bloco *k = b->primeiro; b->primeiro = k->prox; free(k); }
+        free(b);
+    }
+    pthread_mutex_unlock(&buffers_m);
+    fclose(f);
+}
+
+void trace_junta(int partes, int nprocs) {
+    if (!trace_ativo) return;
+    FILE *out = fopen(arquivo, "w");
+    if (!out) { perror(arquivo); return; }
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", out);
+    char nome[600], buf[1 << 16];
+    for (int p = 0; p < partes; p++) {
+        snprintf(nome, sizeof(nome), "%s.%d", arquivo, p);
+        FILE *in = fopen(nome, "r");
+        if (!in) { perror(nome); continue; }
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), in)) > 0) fwrite(buf, 1, n, out);
+        fclose(in);
+        remove(nome);
+    }
+    for (int p = 0; p < nprocs; p++)
+        fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"snapshot\"}},\n"
+                     "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"P%d\"}}%s\n",
+                p, TRACE_SNAPSHOT, p, p, p == nprocs - 1 ? "" : ",");
+    fputs("]}\n", out);
+    fclose(out);
+}
@@ -0,0 +1,51 @@
+/**
+ * Trace no formato Chrome Trace Event (JSON), aberto no Perfetto (ui.perfetto.dev)
+ * ou em chrome://tracing
+ *
+ * Uso: trace_init(arquivo) liga a coleta; cada thread chama trace_thread(rank, tid,
+ *      nome) ao começar e registra fatias (ph "X") e pontas de fluxo (ph "s"/"f")
+ *      no próprio buffer, sem trava. No fim, trace_fim(parte) formata os buffers do
+ *      processo em <arquivo>.<parte> e trace_junta(partes, nprocs), num só processo
+ *      e depois que todas as partes foram escritas, monta <arquivo> e apaga as partes.
+ *
+ * pid no trace = rank, tid = TRACE_* abaixo. Um fluxo liga o envio ao recebimento:
+ * o id é o par (remetente, entrada do remetente no relógio da mensagem), único por
+ * envio e conhecido pelos dois lados. Os tempos vêm de CLOCK_MONOTONIC, comparáveis
+ * entre processos do mesmo nó.
+ *
+ * Desligado (trace_ativo == 0) cada ponto de coleta custa um teste.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <time.h>
+
+//trilhas (tid) de cada rank
+enum { TRACE_RELOGIO = 1, TRACE_SAIDA, TRACE_ENTRADA, TRACE_AGENDA, TRACE_SNAPSHOT };
+
+extern int trace_ativo;
+
+//0 se o arquivo não pôde ser criado
+int trace_init(const char *arquivo);
+void trace_thread(int rank, int tid, const char *nome);
+//fatia [t0, t1] (ns) na trilha tid (-1: a da thread), com o relógio após o evento
+void trace_fatia(int tid, const char *nome, uint64_t t0, uint64_t t1, char label, char outro,
+                 const int *clock, int n);
+//ponta de fluxo: fase 's' (dentro da fatia de envio) ou 'f' (dentro da de recebimento)
+void trace_fluxo(char fase, uint64_t id, uint64_t ts);
+void trace_fim(int parte);
+void trace_junta(int partes, int nprocs);
+
+static inline uint64_t trace_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t trace_id(int remetente, int entrada) {
+    return ((uint64_t)(uint32_t)remetente << 32) | (uint32_t)entrada;
+}
+
+#endif
@@ -0,0 +1,38 @@
+/**
+ * Relógio vetorial compartilhado: versões com N dinâmico
+ * Ver vclock.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "vclock.h"
+
+void vclock_max(int *dst, const int *src, int n) {
+    vclock_max_n(dst, src, n);
+}
+
+VcOrdem vclock_compara(const int *a, const int *b, int n) {
+    return vclock_compara_n(a, b, n);
+}
+
+void vclock_print(int pid, const int *p, int n, char label, int tipo, char outroLabel) {
+    //linha montada antes: threads imprimindo juntas não se intercalam
+    char pilha[256], *buf = n <= 16 ? pilha : malloc(64 + 12*(size_t)n), *s = buf;
+    s += sprintf(s, "P%d|%c (", pid, label);
+    for (int i = 0; i < n; i++) s += sprintf(s, i ? ", %d" : "%d", p[i]);
+    switch (tipo) {
+        case VC_EVENTO: sprintf(s, ") evento interno\n"); break;
+        //sem o rótulo do outro lado (0) a linha sai sem "para/de": um NUL cortaria o '\n'
+        case VC_ENVIO: sprintf(s, outroLabel ? ") envio para %c\n" : ") envio\n", outroLabel); break;
+        case VC_RECEBIMENTO: sprintf(s, outroLabel ? ") recebido de %c\n" : ") recebido\n", outroLabel); break;
+    }
+    fputs(buf, stdout);
+    fflush(stdout);
+    if (buf != pilha) free(buf);
+}
+
+void vclock_print_vec(const int *p, int n) {
+    putchar('(');
+    for (int i = 0; i < n; i++) printf(i ? ",%d" : "%d", p[i]);
+    putchar(')');
+}
@@ -0,0 +1,58 @@
+/**
+ * Relógio vetorial compartilhado pelas etapas
+ *
+ * Compilação: make (gera libcomum.a)
+ * Uso:        #include "vclock.h" e ligar com ../comum/libcomum.a
+ *
+ * VCLOCK_DEF(T, N) define o tipo T { int p[N]; } e as funções T_max, T_compara e
+ * T_print, especializadas para o N da compilação: com N constante e as funções
+ * inline o compilador desenrola os laços por inteiro (N pequeno) ou os vetoriza.
+ * Quando N só é conhecido na execução valem vclock_max, vclock_compara e
+ * vclock_print, com a mesma semântica sobre um vetor de n ints.
+ */
+
+#ifndef VCLOCK_H
+#define VCLOCK_H
+
+//resultado da comparação de dois relógios
+typedef enum { VC_IGUAL, VC_ANTES, VC_DEPOIS, VC_CONCORRENTE } VcOrdem;
+
+//mesma ordem do TipoEvento das etapas
+enum { VC_EVENTO, VC_ENVIO, VC_RECEBIMENTO };
+
+/* ------------------------------- N dinâmico -------------------------------- */
+
+void vclock_max(int *dst, const int *src, int n);
+VcOrdem vclock_compara(const int *a, const int *b, int n);
+//"P0|a (1, 0, 0) evento interno", numa só escrita em stdout
+void vclock_print(int pid, const int *p, int n, char label, int tipo, char outroLabel);
+//"(1,0,0)" sem quebra de linha
+void vclock_print_vec(const int *p, int n);
+
+/* ------------------------- N de tempo de compilação ------------------------ */
+
+static inline void vclock_max_n(int *dst, const int *src, const int n) {
+#pragma GCC unroll 16
+    for (int i = 0; i < n; i++)
+        dst[i] = src[i] > dst[i] ? src[i] : dst[i];
+}
+
+static inline VcOrdem vclock_compara_n(const int *a, const int *b, const int n) {
+    int menor = 0, maior = 0;
+#pragma GCC unroll 16
+    for (int i = 0; i < n; i++) {
+        menor |= a[i] < b[i];
+        maior |= a[i] > b[i];
+    }
+    return menor ? (maior ? VC_CONCORRENTE : VC_ANTES) : (maior ? VC_DEPOIS : VC_IGUAL);
+}
+
+#define VCLOCK_DEF(T, N)                                                              \
+    typedef struct T { int p[N]; } T;                                                 \
+    static inline void T##_max(T *dst, const T *src) { vclock_max_n(dst->p, src->p, N); } \
+    static inline VcOrdem T##_compara(const T *a, const T *b) { return vclock_compara_n(a->p, b->p, N); } \
+    static inline void T##_print(int pid, const T *c, char label, int tipo, char outroLabel) { \
+        vclock_print(pid, c->p, N, label, tipo, outroLabel);                         \
+    }
+
+#endif